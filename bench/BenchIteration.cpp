@@ -0,0 +1,135 @@
+#include "Attractadore/DenseSlotMap.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <span>
+#include <vector>
+
+using Attractadore::DenseSlotMap;
+
+namespace {
+constexpr size_t NUM_ELEMENTS = 1 << 20;
+constexpr int NUM_ITERATIONS = 200;
+
+// Keep the compiler from hoisting loop invariant work out of the benchmark
+void clobber() {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : : "memory");
+#endif
+}
+
+template <typename F> void bench(const char *name, F f) {
+  float result = 0.0f;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    clobber();
+    result += f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  auto ns = std::chrono::duration<double, std::nano>(end - start).count();
+  std::printf("%-24s %8.3f ns/element (%g)\n", name,
+              ns / (double(NUM_ELEMENTS) * NUM_ITERATIONS), result);
+}
+
+void scale(std::span<float> values) {
+  for (auto &v : values) {
+    v *= 1.0001f;
+  }
+}
+
+// Integer, since a float sum cannot be reordered to vectorize
+uint32_t sum(std::span<const uint32_t> values) {
+  uint32_t s = 0;
+  for (auto v : values) {
+    s += v;
+  }
+  return s;
+}
+} // namespace
+
+int main() {
+  std::vector<float> raw(NUM_ELEMENTS);
+  std::iota(raw.begin(), raw.end(), 0.0f);
+
+  DenseSlotMap<float> map;
+  map.reserve(NUM_ELEMENTS);
+  for (auto v : raw) {
+    std::ignore = map.insert(v);
+  }
+
+  bench("scale raw array", [&] {
+    scale(raw);
+    return raw[0];
+  });
+  bench("scale iterator", [&] {
+    for (auto &&[k, v] : map) {
+      v *= 1.0001f;
+    }
+    return map.front().second;
+  });
+  bench("scale for_each_span", [&] {
+    map.for_each_span([](auto, std::span<float> values) { scale(values); });
+    return map.front().second;
+  });
+
+  std::vector<uint32_t> int_raw(NUM_ELEMENTS);
+  std::iota(int_raw.begin(), int_raw.end(), 0u);
+
+  DenseSlotMap<uint32_t> int_map;
+  int_map.reserve(NUM_ELEMENTS);
+  for (auto v : int_raw) {
+    std::ignore = int_map.insert(v);
+  }
+
+  bench("sum raw array", [&] { return float(sum(int_raw)); });
+  bench("sum iterator", [&] {
+    uint32_t s = 0;
+    for (auto &&[k, v] : std::as_const(int_map)) {
+      s += v;
+    }
+    return float(s);
+  });
+  bench("sum for_each_span", [&] {
+    uint32_t s = 0;
+    std::as_const(int_map).for_each_span(
+        [&](auto, std::span<const uint32_t> values) { s += sum(values); });
+    return float(s);
+  });
+
+  // Shuffle the dense order of a copy and drop a quarter of it, so that
+  // probing it by the original's keys misses the cache
+  auto other = map;
+  std::vector<Attractadore::SlotMapKey> keys(map.keys().begin(),
+                                             map.keys().end());
+  std::mt19937 gen;
+  std::ranges::shuffle(keys, gen);
+  for (auto k : keys) {
+    other.touch(k);
+  }
+  for (size_t i = 0; i < keys.size(); i += 4) {
+    other.erase(keys[i]);
+  }
+
+  // Drive from the smaller map, as join does
+  bench("join find loop", [&] {
+    float s = 0.0f;
+    for (auto &&[k, o] : std::as_const(other)) {
+      if (auto *v = std::as_const(map).get(k)) {
+        s += *v * o;
+      }
+    }
+    return s;
+  });
+  bench("join view", [&] {
+    float s = 0.0f;
+    for (auto &&[k, v, o] : Attractadore::join(std::as_const(map),
+                                               std::as_const(other))) {
+      s += v * o;
+    }
+    return s;
+  });
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include "DenseSlotMap.hpp"
+
+#include <atomic>
+
+namespace Attractadore {
+
+// Keys reserved in a DenseSlotMap ahead of time, which any number of threads
+// can take concurrently. A reserved key is not contained in the map until a
+// CommandBuffer emplaces a value at it. Reservations must not be outstanding
+// while the map is cleared, merged or restored.
+template <typename Map> class KeyPool {
+  static_assert(detail::IsDenseSlotMap<Map>);
+
+public:
+  using key_type = typename Map::key_type;
+  using size_type = size_t;
+
+private:
+  std::vector<key_type> m_keys;
+  std::atomic<size_type> m_next = 0;
+
+public:
+  KeyPool() = default;
+  KeyPool(const KeyPool &) = delete;
+  KeyPool &operator=(const KeyPool &) = delete;
+
+  // Release the reservations that were not used and reserve count new keys.
+  // Must be called after the buffers that used the old keys were applied.
+  void refill(Map &map, size_type count) {
+    release(map);
+    m_keys.reserve(count);
+    for (size_type i = 0; i < count; i++) {
+      m_keys.push_back(map.reserve_slot());
+    }
+  }
+
+  void release(Map &map) noexcept {
+    for (auto k : m_keys) {
+      if (map.is_reserved(k)) {
+        map.release_reserved(k);
+      }
+    }
+    m_keys.clear();
+    m_next.store(0, std::memory_order_relaxed);
+  }
+
+  // Thread safe. Returns a null key if the pool is exhausted.
+  [[nodiscard]] key_type reserve_key() noexcept {
+    auto i = m_next.fetch_add(1, std::memory_order_relaxed);
+    return i < m_keys.size() ? m_keys[i] : key_type();
+  }
+
+  size_type available() const noexcept {
+    auto next = m_next.load(std::memory_order_relaxed);
+    return m_keys.size() - std::min(next, m_keys.size());
+  }
+};
+
+// Emplace and erase commands recorded by one thread and applied to a
+// DenseSlotMap later. New elements get their keys from a KeyPool right away,
+// so the keys can be used before the commands are applied.
+template <typename Map> class CommandBuffer {
+  static_assert(detail::IsDenseSlotMap<Map>);
+
+public:
+  using key_type = typename Map::key_type;
+  using value_type = typename Map::value_type;
+  using size_type = size_t;
+
+private:
+  struct Command {
+    key_type key;
+    // Empty for erase
+    std::optional<value_type> value;
+  };
+
+  KeyPool<Map> *m_pool;
+  std::vector<Command> m_commands;
+
+public:
+  explicit CommandBuffer(KeyPool<Map> &pool) noexcept : m_pool{&pool} {}
+
+  bool empty() const noexcept { return m_commands.empty(); }
+
+  size_type size() const noexcept { return m_commands.size(); }
+
+  [[nodiscard]] key_type reserve_key() noexcept {
+    return m_pool->reserve_key();
+  }
+
+  // Returns a null key, and records nothing, if the pool is exhausted
+  template <typename... Args>
+    requires std::constructible_from<value_type, Args &&...>
+  [[nodiscard]] key_type emplace(Args &&...args) {
+    auto k = reserve_key();
+    if (not k.is_null()) {
+      emplace_at(k, std::forward<Args>(args)...);
+    }
+    return k;
+  }
+
+  // Emplace at a key taken with reserve_key()
+  template <typename... Args>
+    requires std::constructible_from<value_type, Args &&...>
+  void emplace_at(key_type k, Args &&...args) {
+    assert(not k.is_null());
+    m_commands.push_back(
+        {k, std::optional<value_type>(std::in_place,
+                                      std::forward<Args>(args)...)});
+  }
+
+  // Erase an element of the map or one emplaced by an earlier command.
+  // Erasing a key that is gone by then does nothing.
+  void erase(key_type k) { m_commands.push_back({k, std::nullopt}); }
+
+  void clear() noexcept { m_commands.clear(); }
+
+  // Execute and clear all commands, in the order they were recorded. An
+  // emplace is dropped if its key was erased by a buffer applied earlier.
+  void apply(Map &map) {
+    for (auto &[k, value] : m_commands) {
+      if (value) {
+        if (map.is_reserved(k)) {
+          map.emplace_reserved(k, std::move(*value));
+        }
+      } else if (not map.try_erase(k) and map.is_reserved(k)) {
+        map.release_reserved(k);
+      }
+    }
+    m_commands.clear();
+  }
+};
+
+// Apply the buffers one after another
+template <typename Map, typename... Buffers>
+  requires(std::same_as<Buffers, CommandBuffer<Map>> and ...)
+void apply(Map &map, Buffers &...buffers) {
+  (buffers.apply(map), ...);
+}
+
+} // namespace Attractadore
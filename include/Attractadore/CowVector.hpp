@@ -0,0 +1,297 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace Attractadore {
+namespace detail {
+
+// Vector made of fixed size chunks that are shared between copies and only
+// copied on first write. Copying a CowVector copies the chunk table, not the
+// elements. Non-const access unshares the chunk it touches, even if it only
+// reads, so read through a const reference to keep chunks shared.
+template <typename T, size_t ChunkSize = std::max<size_t>(4096 / sizeof(T), 1)>
+class CowVector {
+  struct Chunk {
+    alignas(T) std::byte storage[ChunkSize * sizeof(T)];
+    size_t count = 0;
+
+    Chunk() = default;
+
+    Chunk(const Chunk &other) {
+      std::uninitialized_copy_n(other.data(), other.count, data());
+      count = other.count;
+    }
+
+    Chunk &operator=(const Chunk &) = delete;
+
+    ~Chunk() { std::destroy_n(data(), count); }
+
+    const T *data() const noexcept {
+      return std::launder(reinterpret_cast<const T *>(storage));
+    }
+
+    T *data() noexcept { return std::launder(reinterpret_cast<T *>(storage)); }
+  };
+
+  std::vector<std::shared_ptr<Chunk>> m_chunks;
+  size_t m_size = 0;
+
+  template <bool Const> class Iterator {
+    friend class CowVector;
+    friend class Iterator<not Const>;
+
+    using Owner = std::conditional_t<Const, const CowVector, CowVector>;
+
+    Owner *m_vec = nullptr;
+    std::ptrdiff_t m_index = 0;
+
+    Iterator(Owner *vec, std::ptrdiff_t index) noexcept
+        : m_vec{vec}, m_index{index} {}
+
+  public:
+    using iterator_concept = std::random_access_iterator_tag;
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::conditional_t<Const, const T &, T &>;
+
+    Iterator() = default;
+
+    Iterator(const Iterator<not Const> &other) noexcept
+      requires Const
+        : m_vec{other.m_vec}, m_index{other.m_index} {}
+
+    reference operator*() const noexcept { return (*m_vec)[m_index]; }
+
+    auto operator->() const noexcept { return &**this; }
+
+    reference operator[](difference_type d) const noexcept {
+      return (*m_vec)[m_index + d];
+    }
+
+    Iterator &operator++() noexcept {
+      ++m_index;
+      return *this;
+    }
+
+    Iterator operator++(int) noexcept {
+      auto temp = *this;
+      ++m_index;
+      return temp;
+    }
+
+    Iterator &operator--() noexcept {
+      --m_index;
+      return *this;
+    }
+
+    Iterator operator--(int) noexcept {
+      auto temp = *this;
+      --m_index;
+      return temp;
+    }
+
+    Iterator &operator+=(difference_type d) noexcept {
+      m_index += d;
+      return *this;
+    }
+
+    Iterator &operator-=(difference_type d) noexcept {
+      m_index -= d;
+      return *this;
+    }
+
+    Iterator operator+(difference_type d) const noexcept {
+      return {m_vec, m_index + d};
+    }
+
+    friend Iterator operator+(difference_type d, Iterator it) noexcept {
+      return it + d;
+    }
+
+    Iterator operator-(difference_type d) const noexcept {
+      return {m_vec, m_index - d};
+    }
+
+    difference_type operator-(const Iterator &other) const noexcept {
+      assert(m_vec == other.m_vec);
+      return m_index - other.m_index;
+    }
+
+    bool operator==(const Iterator &other) const noexcept {
+      assert(m_vec == other.m_vec);
+      return m_index == other.m_index;
+    }
+
+    std::strong_ordering operator<=>(const Iterator &other) const noexcept {
+      assert(m_vec == other.m_vec);
+      return m_index <=> other.m_index;
+    }
+  };
+
+public:
+  using value_type = T;
+  using size_type = size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = T &;
+  using const_reference = const T &;
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  static constexpr size_t chunk_size = ChunkSize;
+
+  CowVector() = default;
+  CowVector(const CowVector &) = default;
+  CowVector(CowVector &&) noexcept = default;
+  CowVector &operator=(CowVector &&) noexcept = default;
+  ~CowVector() = default;
+
+  // Assigning a copy back only replaces the chunks that differ, so restoring
+  // a snapshot does no reference counting for chunks that were not written
+  // since it was taken
+  CowVector &operator=(const CowVector &other) {
+    if (this == &other) {
+      return *this;
+    }
+    auto common = std::min(m_chunks.size(), other.m_chunks.size());
+    for (size_t i = 0; i < common; i++) {
+      if (m_chunks[i] != other.m_chunks[i]) {
+        m_chunks[i] = other.m_chunks[i];
+      }
+    }
+    m_chunks.resize(common);
+    m_chunks.insert(m_chunks.end(), other.m_chunks.begin() + common,
+                    other.m_chunks.end());
+    m_size = other.m_size;
+    return *this;
+  }
+
+  size_type size() const noexcept { return m_size; }
+
+  bool empty() const noexcept { return m_size == 0; }
+
+  const_iterator begin() const noexcept { return {this, 0}; }
+
+  const_iterator end() const noexcept {
+    return {this, static_cast<difference_type>(m_size)};
+  }
+
+  iterator begin() noexcept { return {this, 0}; }
+
+  iterator end() noexcept {
+    return {this, static_cast<difference_type>(m_size)};
+  }
+
+  const T &operator[](size_type idx) const noexcept {
+    assert(idx < m_size);
+    return m_chunks[idx / ChunkSize]->data()[idx % ChunkSize];
+  }
+
+  T &operator[](size_type idx) {
+    assert(idx < m_size);
+    return unshare(idx / ChunkSize).data()[idx % ChunkSize];
+  }
+
+  const T &back() const noexcept { return (*this)[m_size - 1]; }
+
+  T &back() { return (*this)[m_size - 1]; }
+
+  void reserve(size_type capacity) {
+    m_chunks.reserve((capacity + ChunkSize - 1) / ChunkSize);
+  }
+
+  void shrink_to_fit() { m_chunks.shrink_to_fit(); }
+
+  void clear() noexcept {
+    m_chunks.clear();
+    m_size = 0;
+  }
+
+  void push_back(const T &value) { emplace_back(value); }
+
+  void push_back(T &&value) { emplace_back(std::move(value)); }
+
+  template <typename... Args> T &emplace_back(Args &&...args) {
+    if (m_size % ChunkSize == 0) {
+      m_chunks.push_back(std::make_shared<Chunk>());
+    }
+    auto &chunk = unshare(m_chunks.size() - 1);
+    auto *ptr = std::construct_at(chunk.data() + chunk.count,
+                                  std::forward<Args>(args)...);
+    chunk.count++;
+    m_size++;
+    return *ptr;
+  }
+
+  void pop_back() {
+    assert(not empty());
+    auto &chunk = unshare(m_chunks.size() - 1);
+    std::destroy_at(chunk.data() + --chunk.count);
+    if (chunk.count == 0) {
+      m_chunks.pop_back();
+    }
+    m_size--;
+  }
+
+  void resize(size_type size, const T &value) {
+    while (m_size > size) {
+      pop_back();
+    }
+    while (m_size < size) {
+      push_back(value);
+    }
+  }
+
+  // Only appending is supported
+  template <std::input_iterator I>
+  iterator insert([[maybe_unused]] const_iterator pos, I first, I last) {
+    assert(pos == end());
+    auto index = static_cast<difference_type>(m_size);
+    for (; first != last; ++first) {
+      emplace_back(*first);
+    }
+    return {this, index};
+  }
+
+  bool operator==(const CowVector &other) const {
+    if (m_size != other.m_size) {
+      return false;
+    }
+    for (size_t i = 0; i < m_chunks.size(); i++) {
+      const auto &l = *m_chunks[i];
+      const auto &r = *other.m_chunks[i];
+      if (&l != &r and
+          not std::equal(l.data(), l.data() + l.count, r.data())) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Number of chunks not shared with any other copy
+  size_type unshared_chunks() const noexcept {
+    return std::ranges::count_if(
+        m_chunks, [](const auto &chunk) { return chunk.use_count() == 1; });
+  }
+
+private:
+  Chunk &unshare(size_type chunk_index) {
+    auto &chunk = m_chunks[chunk_index];
+    if (chunk.use_count() > 1) {
+      chunk = std::make_shared<Chunk>(*chunk);
+    }
+    return *chunk;
+  }
+};
+
+} // namespace detail
+
+template <typename T> using CowChunkedVector = detail::CowVector<T>;
+
+} // namespace Attractadore
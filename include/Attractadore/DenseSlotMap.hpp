@@ -1,9 +1,15 @@
 #pragma once
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
+#include <functional>
 #include <iterator>
 #include <limits>
 #include <optional>
+#include <span>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -244,10 +250,40 @@ operator+(typename ZipIterator<Iter1, Iter2>::difference_type d,
   return it + d;
 }
 
+constexpr void prefetch(const void *ptr) noexcept {
+  if (not std::is_constant_evaluated()) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(ptr);
+#endif
+  }
+}
+
+inline constexpr size_t SPAN_ALIGNMENT = 64;
+
+// Number of leading elements before the first address aligned to
+// SPAN_ALIGNMENT, or 0 if the elements cannot reach it
+template <typename T>
+constexpr size_t unaligned_head(const T *data) noexcept {
+  if constexpr (SPAN_ALIGNMENT % sizeof(T) != 0) {
+    return 0;
+  } else {
+    if (std::is_constant_evaluated()) {
+      return 0;
+    }
+    auto offset = reinterpret_cast<std::uintptr_t>(data) % SPAN_ALIGNMENT;
+    if (offset % sizeof(T) != 0) {
+      return 0;
+    }
+    return (SPAN_ALIGNMENT - offset) % SPAN_ALIGNMENT / sizeof(T);
+  }
+}
+
 template <typename T> constexpr bool EnableSlotMapKey = false;
 
 template <typename T> using StdVector = std::vector<T>;
 
+template <typename T, typename K> class SharedRegion;
+
 } // namespace detail
 
 template <typename K>
@@ -255,15 +291,52 @@ concept CSlotMapKey = detail::EnableSlotMapKey<K>;
 
 class SlotMapKey;
 
+// What the dense key array of a DenseSlotMap holds. With SlotIndex, only the
+// slot index of every element is stored and keys() rebuilds the keys from the
+// slot versions, which halves the array at the cost of an extra slot lookup
+// per key read.
+enum class KeyStorage {
+  Key,
+  SlotIndex,
+};
+
 template <typename T, CSlotMapKey K = SlotMapKey,
-          template <typename> typename C = detail::StdVector>
+          template <typename> typename C = detail::StdVector,
+          KeyStorage S = KeyStorage::Key>
 class DenseSlotMap;
 
+template <typename... Maps> class JoinView;
+
+enum class MergeKeys {
+  Remap,
+  Preserve,
+};
+
+template <CSlotMapKey K = SlotMapKey,
+          template <typename> typename C = detail::StdVector>
+class KeyRegistry;
+
+template <typename T, CSlotMapKey K = SlotMapKey,
+          template <typename> typename C = detail::StdVector>
+class AttachedStore;
+
+template <CSlotMapKey K, template <typename> typename C, typename Base,
+          typename... Derived>
+class BasicPolySlotMap;
+
 #define ATTRACTADORE_DEFINE_SLOTMAP_KEY(NewKey)                                \
   class NewKey {                                                               \
     template <typename T, ::Attractadore::CSlotMapKey K,                       \
-              template <typename> typename C>                                  \
+              template <typename> typename C, ::Attractadore::KeyStorage S>    \
     friend class ::Attractadore::DenseSlotMap;                                 \
+    template <::Attractadore::CSlotMapKey K, template <typename> typename C>   \
+    friend class ::Attractadore::KeyRegistry;                                  \
+    template <typename T, ::Attractadore::CSlotMapKey K,                       \
+              template <typename> typename C>                                  \
+    friend class ::Attractadore::AttachedStore;                                \
+    template <::Attractadore::CSlotMapKey K, template <typename> typename C,   \
+              typename Base, typename... Derived>                              \
+    friend class ::Attractadore::BasicPolySlotMap;                             \
     uint32_t slot_index = std::numeric_limits<uint32_t>::max();                \
     uint32_t version = 0;                                                      \
                                                                                \
@@ -291,8 +364,14 @@ namespace detail {
 
 template <typename Container> struct ContainerView : private Container {
   template <typename T, ::Attractadore::CSlotMapKey K,
-            template <typename> typename C>
+            template <typename> typename C, ::Attractadore::KeyStorage S>
   friend class ::Attractadore::DenseSlotMap;
+  template <typename T, ::Attractadore::CSlotMapKey K,
+            template <typename> typename C>
+  friend class ::Attractadore::AttachedStore;
+  template <::Attractadore::CSlotMapKey K, template <typename> typename C,
+            typename Base, typename... Derived>
+  friend class ::Attractadore::BasicPolySlotMap;
 
   using typename Container::const_iterator;
   using typename Container::difference_type;
@@ -348,35 +427,36 @@ template <typename Container> struct ContainerView : private Container {
   constexpr const value_type *cdata() const noexcept
     requires requires {
                {
-                 ContainerView::data()
+                 Container::data()
                  } -> std::convertible_to<const value_type *>;
              }
   {
-    return ContainerView::data();
+    return Container::data();
   }
 
   constexpr const value_type *data() const noexcept
     requires requires {
                {
-                 ContainerView::data()
+                 Container::data()
                  } -> std::convertible_to<const value_type *>;
              }
   {
-    return ContainerView::data();
+    return Container::data();
   }
 
   constexpr value_type *data() noexcept
     requires requires {
-               { ContainerView::data() } -> std::convertible_to<value_type *>;
+               { Container::data() } -> std::convertible_to<value_type *>;
              }
   {
-    return ContainerView::data();
+    return Container::data();
   }
 };
 
 } // namespace detail
 
-template <typename T, CSlotMapKey K, template <typename> typename C>
+template <typename T, CSlotMapKey K, template <typename> typename C,
+          KeyStorage S>
 class DenseSlotMap {
   static constexpr auto NULL_SLOT = std::numeric_limits<uint32_t>::max();
 
@@ -388,7 +468,10 @@ class DenseSlotMap {
     uint32_t version;
   };
 
-  using Keys = C<K>;
+  static constexpr bool STORE_KEYS = S == KeyStorage::Key;
+
+  using stored_key_type = std::conditional_t<STORE_KEYS, K, uint32_t>;
+  using Keys = C<stored_key_type>;
   using Values = C<T>;
   using Slots = C<Slot>;
   using KeyView = detail::ContainerView<Keys>;
@@ -398,24 +481,45 @@ class DenseSlotMap {
   Values m_values;
   Slots m_slots;
 
-  struct FreeHead {
-    uint32_t value = NULL_SLOT;
-    FreeHead() = default;
-    FreeHead(const FreeHead &other) = default;
-    FreeHead(FreeHead &other) noexcept
-        : value(std::exchange(other.value, NULL_SLOT)) {}
-    FreeHead &operator=(const FreeHead &other) = default;
-    FreeHead &operator=(FreeHead &other) noexcept {
-      value = other.value;
-      other.value = NULL_SLOT;
+  // Reset to Empty when moved from, so that a moved-from map does not refer
+  // to slots it no longer has
+  template <uint32_t Empty> struct ResetOnMove {
+    uint32_t value = Empty;
+    ResetOnMove() = default;
+    ResetOnMove(const ResetOnMove &other) = default;
+    ResetOnMove(ResetOnMove &other) noexcept
+        : value(std::exchange(other.value, Empty)) {}
+    ResetOnMove(ResetOnMove &&other) noexcept
+        : value(std::exchange(other.value, Empty)) {}
+    ResetOnMove &operator=(const ResetOnMove &other) = default;
+    ResetOnMove &operator=(ResetOnMove &other) noexcept {
+      value = std::exchange(other.value, Empty);
+      return *this;
+    }
+    ResetOnMove &operator=(ResetOnMove &&other) noexcept {
+      value = std::exchange(other.value, Empty);
       return *this;
     }
-    FreeHead &operator=(uint32_t new_value) noexcept {
+    ResetOnMove &operator=(uint32_t new_value) noexcept {
       value = new_value;
       return *this;
     }
     operator uint32_t() const noexcept { return value; }
-  } m_free_head;
+  };
+
+  using FreeHead = ResetOnMove<NULL_SLOT>;
+
+  FreeHead m_free_head;
+  // Slots below m_lazy_free were freed by clear() and are not on the free list
+  ResetOnMove<0> m_lazy_free;
+  // Elements below m_active_end are active, the rest inactive
+  ResetOnMove<0> m_active_end;
+  // Keys with versions below m_version_floor were issued before the last
+  // clear() and are no longer valid
+  uint32_t m_version_floor = 0;
+  uint32_t m_max_version = 0;
+  // Erased values kept alive for emplace_recycled()
+  Values m_recycled;
 
   static_assert(std::ranges::borrowed_range<const KeyView &>);
   static_assert(std::ranges::borrowed_range<const ValueView &>);
@@ -423,8 +527,107 @@ class DenseSlotMap {
   static_assert(std::ranges::random_access_range<const KeyView &>);
   static_assert(std::ranges::random_access_range<const ValueView &>);
   static_assert(std::ranges::random_access_range<ValueView &>);
+  static_assert(not std::ranges::contiguous_range<Keys> or
+                std::ranges::contiguous_range<const KeyView &>);
+  static_assert(not std::ranges::contiguous_range<Values> or
+                std::ranges::contiguous_range<ValueView &>);
+
+  // Builds keys from the stored slot indices and the slot versions
+  class KeyIterator {
+    friend class DenseSlotMap;
+
+    using Base = typename Keys::const_iterator;
+
+    Base m_it = {};
+    const Slots *m_slots = nullptr;
+
+    constexpr KeyIterator(Base it, const Slots *slots) noexcept
+        : m_it{it}, m_slots{slots} {}
+
+  public:
+    using iterator_concept = std::random_access_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = K;
+    using difference_type = std::iter_difference_t<Base>;
+    using reference = K;
+
+    KeyIterator() = default;
+
+    constexpr K operator*() const noexcept {
+      if constexpr (STORE_KEYS) {
+        return *m_it;
+      } else {
+        auto slot_index = *m_it;
+        return make_key(slot_index, (*m_slots)[slot_index].version);
+      }
+    }
+
+    constexpr K operator[](difference_type d) const noexcept {
+      return *(*this + d);
+    }
+
+    constexpr KeyIterator &operator++() noexcept {
+      ++m_it;
+      return *this;
+    }
+
+    constexpr KeyIterator operator++(int) noexcept {
+      auto temp = *this;
+      ++m_it;
+      return temp;
+    }
+
+    constexpr KeyIterator &operator--() noexcept {
+      --m_it;
+      return *this;
+    }
+
+    constexpr KeyIterator operator--(int) noexcept {
+      auto temp = *this;
+      --m_it;
+      return temp;
+    }
+
+    constexpr KeyIterator &operator+=(difference_type d) noexcept {
+      m_it += d;
+      return *this;
+    }
+
+    constexpr KeyIterator &operator-=(difference_type d) noexcept {
+      m_it -= d;
+      return *this;
+    }
+
+    constexpr KeyIterator operator+(difference_type d) const noexcept {
+      return {m_it + d, m_slots};
+    }
+
+    friend constexpr KeyIterator operator+(difference_type d,
+                                           KeyIterator it) noexcept {
+      return it + d;
+    }
+
+    constexpr KeyIterator operator-(difference_type d) const noexcept {
+      return {m_it - d, m_slots};
+    }
+
+    constexpr difference_type
+    operator-(const KeyIterator &other) const noexcept {
+      return m_it - other.m_it;
+    }
+
+    constexpr bool operator==(const KeyIterator &other) const noexcept {
+      return m_it == other.m_it;
+    }
 
-  using const_key_iterator = typename KeyView::const_iterator;
+    constexpr auto operator<=>(const KeyIterator &other) const noexcept {
+      return m_it <=> other.m_it;
+    }
+  };
+
+  using const_key_iterator =
+      std::conditional_t<STORE_KEYS, typename KeyView::const_iterator,
+                         KeyIterator>;
 
   using const_value_iterator = typename ValueView::const_iterator;
   using value_iterator = typename ValueView::iterator;
@@ -440,8 +643,13 @@ public:
   using difference_type = std::iter_difference_t<iterator>;
   using size_type = std::make_unsigned_t<difference_type>;
 
-  constexpr const auto &keys() const noexcept {
-    return static_cast<const KeyView &>(m_keys);
+  constexpr decltype(auto) keys() const noexcept {
+    if constexpr (STORE_KEYS) {
+      return static_cast<const KeyView &>(m_keys);
+    } else {
+      return std::ranges::subrange(KeyIterator(m_keys.begin(), &m_slots),
+                                   KeyIterator(m_keys.end(), &m_slots));
+    }
   }
 
   constexpr const auto &values() const noexcept {
@@ -470,6 +678,51 @@ public:
 
   constexpr iterator end() noexcept { return {keys().end(), values().end()}; }
 
+  // Call f(std::span<const key_type>, std::span<value_type>) on consecutive
+  // blocks of at most block_size elements. Loops over spans vectorize the
+  // way loops over raw arrays do, unlike loops over iterator. In
+  // KeyStorage::SlotIndex mode, f gets the stored std::span<const uint32_t>
+  // slot indices instead of keys. When there is more than one block, a
+  // shorter head block is peeled off so that the value blocks after it start
+  // on 64 byte boundaries, provided block_size values span whole multiples
+  // of 64 bytes.
+#define attractadore_slotmap_for_each_span(f, block_size)                      \
+  auto *keys = std::ranges::data(m_keys);                                      \
+  auto *values = std::ranges::data(m_values);                                  \
+  size_type count = size();                                                    \
+  assert(block_size > 0);                                                      \
+  size_type first = 0;                                                         \
+  if (block_size < count) {                                                    \
+    first = std::min<size_type>(detail::unaligned_head(values), block_size);   \
+    if (first > 0) {                                                           \
+      std::invoke(f, std::span(keys, first), std::span(values, first));        \
+    }                                                                          \
+  }                                                                            \
+  for (; first < count; first += block_size) {                                 \
+    auto n = std::min(block_size, count - first);                              \
+    std::invoke(f, std::span(keys + first, n), std::span(values + first, n));  \
+  }
+
+  template <typename F>
+    requires std::ranges::contiguous_range<Keys> and
+             std::ranges::contiguous_range<Values> and
+             std::invocable<F &, std::span<const stored_key_type>,
+                            std::span<const value_type>>
+  constexpr void for_each_span(F &&f, size_type block_size = max_size()) const {
+    attractadore_slotmap_for_each_span(f, block_size);
+  }
+
+  template <typename F>
+    requires std::ranges::contiguous_range<Keys> and
+             std::ranges::contiguous_range<Values> and
+             std::invocable<F &, std::span<const stored_key_type>,
+                            std::span<value_type>>
+  constexpr void for_each_span(F &&f, size_type block_size = max_size()) {
+    attractadore_slotmap_for_each_span(f, block_size);
+  }
+
+#undef attractadore_slotmap_for_each_span
+
   constexpr bool empty() const noexcept { return begin() == end(); }
 
   static constexpr size_type max_size() noexcept { return NULL_SLOT - 1; }
@@ -540,16 +793,20 @@ public:
     m_slots.shrink_to_fit();
   }
 
+  // Constant time apart from destroying the values. Instead of pushing every
+  // slot onto the free list, all slots are marked as lazily freed, and
+  // raising the version floor above every issued version invalidates all
+  // existing keys at once.
   constexpr void clear() noexcept {
-    // Push all objects into free list to preserve version info
-    for (auto [slot_index, version] : m_keys) {
-      m_slots[slot_index] = {
-          .next_free = std::exchange(m_free_head, slot_index),
-          .version = version + 1,
-      };
-    }
     m_keys.clear();
+    while (not m_values.empty() and m_recycled.size() < recycle_capacity()) {
+      pop_back_value();
+    }
     m_values.clear();
+    m_free_head = NULL_SLOT;
+    m_lazy_free = m_slots.size();
+    m_active_end = 0;
+    m_version_floor = m_max_version + 1;
   }
 
   [[nodiscard]] constexpr key_type insert(const value_type &value)
@@ -568,23 +825,48 @@ public:
     requires std::constructible_from<value_type, Args &&...>
   [[nodiscard]] constexpr iterator emplace(Args &&...args) {
     uint32_t index = m_keys.size();
-    auto key = [&] {
-      if (m_free_head == NULL_SLOT) {
-        assert(m_keys.size() == m_slots.size());
-        m_slots.push_back({.index = index});
-        auto slot_index = index;
-        return key_type(slot_index);
-      } else {
-        uint32_t slot_index = m_free_head;
-        auto &slot = m_slots[slot_index];
-        m_free_head = slot.next_free;
-        slot.index = index;
-        return key_type(slot_index, slot.version);
-      }
-    }();
-    m_keys.push_back(key);
+    m_keys.push_back(stored_key(allocate_slot(index)));
     m_values.emplace_back(std::forward<Args>(args)...);
-    return std::ranges::next(begin(), index);
+    return std::ranges::next(begin(), activate_back());
+  }
+
+  // Value recycling: erase() and clear() keep up to reserve_recycled()
+  // erased values instead of destroying them, and emplace_recycled() hands
+  // one back to be reset in place, so heap buffers owned by values are
+  // reused instead of reallocated
+  constexpr void reserve_recycled(size_type capacity)
+    requires requires(size_type capacity) {
+               m_recycled.reserve(capacity);
+               m_recycled.capacity();
+             }
+  {
+    m_recycled.reserve(capacity);
+  }
+
+  constexpr size_type recycled() const noexcept { return m_recycled.size(); }
+
+  constexpr void release_recycled() noexcept {
+    m_recycled.clear();
+    if constexpr (requires { m_recycled.shrink_to_fit(); }) {
+      m_recycled.shrink_to_fit();
+    }
+  }
+
+  // Insert a recycled value, or a default constructed one if there are none,
+  // and call reset on it
+  template <std::invocable<value_type &> F>
+    requires std::default_initializable<value_type>
+  [[nodiscard]] constexpr iterator emplace_recycled(F &&reset) {
+    uint32_t index = m_keys.size();
+    if (m_recycled.empty()) {
+      m_values.emplace_back();
+    } else {
+      m_values.push_back(std::move(m_recycled.back()));
+      m_recycled.pop_back();
+    }
+    m_keys.push_back(stored_key(allocate_slot(index)));
+    std::invoke(std::forward<F>(reset), m_values.back());
+    return std::ranges::next(begin(), activate_back());
   }
 
   constexpr iterator erase(iterator it) noexcept {
@@ -605,7 +887,7 @@ public:
   }
 
   [[nodiscard]] constexpr value_type pop(key_type k) noexcept {
-    auto erase_index = index(k);
+    auto erase_index = deactivate(index(k));
     auto temp = std::exchange(m_values[erase_index], m_values.back());
     m_values.pop_back();
     erase_only_key(erase_index);
@@ -616,7 +898,8 @@ public:
   try_pop(key_type key) noexcept {
     auto it = find(key);
     if (it != end()) {
-      auto erase_index = std::ranges::distance(begin(), it);
+      auto erase_index =
+          deactivate(static_cast<uint32_t>(std::ranges::distance(begin(), it)));
       auto temp = std::exchange(m_values[erase_index], m_values.back());
       m_values.pop_back();
       erase_only_key(erase_index);
@@ -625,19 +908,189 @@ public:
     return std::nullopt;
   }
 
+  // Recency ordering for using the map as a cache: touch() moves an element
+  // halfway towards the front of its partition by swapping it with the
+  // element there, so frequently touched elements gather at the front and
+  // cold ones drift towards the back, where evict_back() removes them. Insert
+  // with emplace_touched(), since emplace() appends at the back, where the
+  // new element would be evicted first. Note that erase() moves the back
+  // element into the erased position.
+  constexpr void touch(key_type k) noexcept {
+    auto index = this->index(k);
+    uint32_t first = index < m_active_end ? 0 : m_active_end;
+    swap_dense(index, first + (index - first) / 2);
+  }
+
+  // Emplace an element and place it as if touched once
+  template <typename... Args>
+    requires std::constructible_from<value_type, Args &&...>
+  [[nodiscard]] constexpr iterator emplace_touched(Args &&...args) {
+    auto index = static_cast<uint32_t>(std::ranges::distance(
+        begin(), emplace(std::forward<Args>(args)...)));
+    swap_dense(index, index / 2);
+    return std::ranges::next(begin(), index / 2);
+  }
+
+  // Active elements are kept in front of inactive ones in the dense arrays,
+  // so loops over active_values() need no per-element check. Elements are
+  // active when inserted. Toggling swaps the element across the boundary.
+  constexpr size_type active_size() const noexcept { return m_active_end; }
+
+  constexpr bool is_active(key_type k) const noexcept {
+    return index(k) < m_active_end;
+  }
+
+  constexpr void set_active(key_type k, bool active) noexcept {
+    auto index = this->index(k);
+    if (active and index >= m_active_end) {
+      swap_dense(index, m_active_end);
+      m_active_end = m_active_end + 1;
+    } else if (not active and index < m_active_end) {
+      deactivate(index);
+    }
+  }
+
+  constexpr auto active_values() const noexcept {
+    return std::ranges::subrange(values().begin(), active_values_end());
+  }
+
+  constexpr auto active_values() noexcept {
+    return std::ranges::subrange(values().begin(), active_values_end());
+  }
+
+  constexpr auto inactive_values() const noexcept {
+    return std::ranges::subrange(active_values_end(), values().end());
+  }
+
+  constexpr auto inactive_values() noexcept {
+    return std::ranges::subrange(active_values_end(), values().end());
+  }
+
+  constexpr void evict_back(size_type n = 1) noexcept {
+    assert(n <= size());
+    for (; n > 0; n--) {
+      erase(static_cast<uint32_t>(m_keys.size() - 1));
+    }
+  }
+
+  class KeyRemap {
+    friend class DenseSlotMap;
+
+    struct Entry {
+      uint32_t old_version;
+      key_type new_key;
+    };
+
+    C<Entry> m_entries;
+
+  public:
+    // Returns the key that old_key was remapped to, or a null key if old_key
+    // did not refer to an element of the merged map
+    constexpr key_type operator()(key_type old_key) const noexcept {
+      if (old_key.slot_index < m_entries.size()) {
+        auto entry = m_entries[old_key.slot_index];
+        if (entry.old_version == old_key.version) {
+          return entry.new_key;
+        }
+      }
+      return {};
+    }
+
+    template <std::ranges::forward_range R>
+      requires std::assignable_from<std::ranges::range_reference_t<R>,
+                                    key_type>
+    constexpr void apply(R &&old_keys) const noexcept {
+      for (auto &&k : old_keys) {
+        k = (*this)(k);
+      }
+    }
+  };
+
+  // Move all elements of other into this map. Values are appended in bulk and
+  // the returned table maps other's keys to their new keys. With
+  // MergeKeys::Preserve, other's keys are kept as is if none of their slots
+  // are in use in this map; otherwise new keys are assigned as with
+  // MergeKeys::Remap.
+  constexpr KeyRemap merge(DenseSlotMap &&other,
+                           MergeKeys mode = MergeKeys::Remap) {
+    KeyRemap remap;
+    remap.m_entries.resize(other.m_slots.size(),
+                           {.old_version = NULL_SLOT, .new_key = key_type()});
+    uint32_t base = m_keys.size();
+    uint32_t other_active = other.m_active_end;
+    bool preserve = mode == MergeKeys::Preserve and can_preserve_keys(other);
+    if (preserve) {
+      if (other.m_slots.size() > m_slots.size()) {
+        m_slots.resize(other.m_slots.size(), {.next_free = NULL_SLOT,
+                                              .version = m_version_floor});
+      }
+      for (uint32_t i = 0; i < other.m_keys.size(); i++) {
+        auto k = other.key_at(i);
+        m_slots[k.slot_index] = {.index = base + i, .version = k.version};
+        m_max_version = std::max(m_max_version, k.version);
+        m_keys.push_back(stored_key(k));
+        remap.m_entries[k.slot_index] = {.old_version = k.version,
+                                         .new_key = k};
+      }
+      rebuild_free_list();
+    } else {
+      for (uint32_t i = 0; i < other.m_keys.size(); i++) {
+        auto old_key = other.key_at(i);
+        auto new_key = allocate_slot(base + i);
+        m_keys.push_back(stored_key(new_key));
+        remap.m_entries[old_key.slot_index] = {.old_version = old_key.version,
+                                               .new_key = new_key};
+      }
+    }
+    m_values.insert(m_values.end(),
+                    std::make_move_iterator(other.m_values.begin()),
+                    std::make_move_iterator(other.m_values.end()));
+    for (uint32_t i = 0; i < other_active; i++) {
+      swap_dense(base + i, m_active_end);
+      m_active_end = m_active_end + 1;
+    }
+    other.clear();
+    return remap;
+  }
+
+  // Snapshots for rollback. With a copy-on-write container like
+  // CowChunkedVector, fork() copies chunk tables and restore() only replaces
+  // the chunks written since the fork, though both still walk every chunk
+  // table. Chunks are copied when first accessed through a non-const map,
+  // including by non-const operator[], get() and iteration.
+  [[nodiscard]] constexpr DenseSlotMap fork() const { return *this; }
+
+  constexpr void restore(const DenseSlotMap &snapshot) { *this = snapshot; }
+
+  // Chunks of the key, value and slot arrays that a copy-on-write container
+  // no longer shares with any fork
+  constexpr std::array<size_t, 3> unshared_chunks() const noexcept
+    requires requires(const Keys &k, const Values &v, const Slots &s) {
+      k.unshared_chunks();
+      v.unshared_chunks();
+      s.unshared_chunks();
+    }
+  {
+    return {m_keys.unshared_chunks(), m_values.unshared_chunks(),
+            m_slots.unshared_chunks()};
+  }
+
   constexpr void swap(DenseSlotMap &other) noexcept {
     std::ranges::swap(m_keys, other.m_keys);
     std::ranges::swap(m_values, other.m_values);
     std::ranges::swap(m_slots, other.m_slots);
     std::ranges::swap(m_free_head, other.m_free_head);
+    std::ranges::swap(m_lazy_free, other.m_lazy_free);
+    std::ranges::swap(m_active_end, other.m_active_end);
+    std::ranges::swap(m_version_floor, other.m_version_floor);
+    std::ranges::swap(m_max_version, other.m_max_version);
+    std::ranges::swap(m_recycled, other.m_recycled);
   }
 
 #define attractadore_slotmap_find(k)                                           \
-  auto slot_index = k.slot_index;                                              \
-  assert(slot_index < m_slots.size());                                         \
-  auto &slot = m_slots[slot_index];                                            \
-  if (slot.version == k.version) {                                             \
-    return std::ranges::next(begin(), slot.index);                             \
+  auto dense_index = find_index(k);                                            \
+  if (dense_index != NULL_SLOT) {                                              \
+    return std::ranges::next(begin(), dense_index);                            \
   }                                                                            \
   return end();
 
@@ -672,10 +1125,266 @@ public:
   };
 
   constexpr bool operator==(const DenseSlotMap &other) const noexcept {
-    return this->m_keys == other.m_keys and this->m_values == other.m_values;
+    if constexpr (STORE_KEYS) {
+      return m_keys == other.m_keys and m_values == other.m_values and
+             m_active_end == other.m_active_end;
+    } else {
+      return std::ranges::equal(keys(), other.keys()) and
+             m_values == other.m_values and
+             m_active_end == other.m_active_end;
+    }
   }
 
 private:
+  template <typename... Maps> friend class JoinView;
+  template <typename Map, typename Sink> friend class JournaledSlotMap;
+  template <typename T2, CSlotMapKey K2, template <typename> typename C2>
+  friend class TtlSlotMap;
+  template <typename T2, typename K2> friend class detail::SharedRegion;
+  template <typename Map> friend class KeyPool;
+  template <typename Map> friend class CommandBuffer;
+  template <typename Map> friend class SlotMapDelta;
+
+  static constexpr std::pair<uint32_t, uint32_t>
+  key_parts(key_type k) noexcept {
+    return {k.slot_index, k.version};
+  }
+
+  static constexpr key_type make_key(uint32_t slot_index,
+                                     uint32_t version) noexcept {
+    return key_type(slot_index, version);
+  }
+
+  // Complete map state, including the free list, for journal checkpoints
+  template <typename Writer> constexpr void write_state(Writer &w) const {
+    w.put(static_cast<uint32_t>(m_keys.size()));
+    w.put(static_cast<uint32_t>(m_slots.size()));
+    w.put(static_cast<uint32_t>(m_free_head));
+    w.put(static_cast<uint32_t>(m_lazy_free));
+    w.put(static_cast<uint32_t>(m_active_end));
+    w.put(m_version_floor);
+    w.put(m_max_version);
+    for (auto k : keys()) {
+      w.put(k.slot_index);
+      w.put(k.version);
+    }
+    for (const auto &value : m_values) {
+      w.put(value);
+    }
+    for (auto slot : m_slots) {
+      w.put(slot.index);
+      w.put(slot.version);
+    }
+  }
+
+  // Returns false if the state is inconsistent: every key must own its slot,
+  // and the free list must only link free slots, in range and without cycles
+  template <typename Reader> constexpr bool read_state(Reader &r) {
+    uint32_t num_keys, num_slots, free_head, lazy_free, active_end;
+    uint32_t version_floor, max_version;
+    if (not(r.get(num_keys) and r.get(num_slots) and r.get(free_head) and
+            r.get(lazy_free) and r.get(active_end) and r.get(version_floor) and
+            r.get(max_version)) or
+        num_keys > num_slots or lazy_free > num_slots or
+        active_end > num_keys or version_floor > max_version + 1) {
+      return false;
+    }
+    m_keys.clear();
+    m_values.clear();
+    m_slots.clear();
+    for (uint32_t i = 0; i < num_keys; i++) {
+      uint32_t slot_index, version;
+      if (not(r.get(slot_index) and r.get(version)) or
+          slot_index >= num_slots or version < version_floor or
+          version > max_version) {
+        return false;
+      }
+      m_keys.push_back(stored_key(key_type(slot_index, version)));
+    }
+    for (uint32_t i = 0; i < num_keys; i++) {
+      value_type value;
+      if (not r.get(value)) {
+        return false;
+      }
+      m_values.push_back(value);
+    }
+    for (uint32_t i = 0; i < num_slots; i++) {
+      Slot slot;
+      if (not(r.get(slot.index) and r.get(slot.version))) {
+        return false;
+      }
+      m_slots.push_back(slot);
+    }
+    for (uint32_t i = 0; i < num_keys; i++) {
+      auto k = key_at(i);
+      auto slot = m_slots[k.slot_index];
+      if (slot.index != i or slot.version != k.version) {
+        return false;
+      }
+    }
+    // Freed slots are taken from the lazily freed ones, so the free list
+    // only links slots at or above lazy_free
+    uint32_t length = 0;
+    for (auto slot_index = free_head; slot_index != NULL_SLOT;
+         slot_index = m_slots[slot_index].next_free) {
+      if (slot_index >= num_slots or slot_index < lazy_free or
+          is_live_slot(slot_index) or ++length > num_slots) {
+        return false;
+      }
+    }
+    m_free_head = free_head;
+    m_lazy_free = lazy_free;
+    m_active_end = active_end;
+    m_version_floor = version_floor;
+    m_max_version = max_version;
+    return true;
+  }
+
+  // Keys whose slot was never allocated by this map are not found. This
+  // happens when probing with keys taken from another map or from a map
+  // restored to an earlier snapshot.
+  constexpr uint32_t find_index(key_type k) const noexcept {
+    if (k.slot_index >= m_slots.size()) {
+      return NULL_SLOT;
+    }
+    // A free slot already has the version of the next key it will hand out,
+    // so a key of another map can match it
+    auto slot = m_slots[k.slot_index];
+    return slot.version == k.version and k.version >= m_version_floor and
+                   slot.index < size() and slot_at(slot.index) == k.slot_index
+               ? slot.index
+               : NULL_SLOT;
+  }
+
+  constexpr key_type allocate_slot(uint32_t index) {
+    uint32_t slot_index = [&] {
+      if (m_free_head != NULL_SLOT) {
+        uint32_t slot_index = m_free_head;
+        m_free_head = m_slots[slot_index].next_free;
+        return slot_index;
+      }
+      if (m_lazy_free != 0) {
+        m_lazy_free = m_lazy_free - 1;
+        return static_cast<uint32_t>(m_lazy_free);
+      }
+      assert(m_keys.size() <= m_slots.size());
+      m_slots.push_back({.index = NULL_SLOT, .version = m_version_floor});
+      return static_cast<uint32_t>(m_slots.size() - 1);
+    }();
+    auto &slot = m_slots[slot_index];
+    slot.index = index;
+    slot.version = std::max(slot.version, m_version_floor);
+    m_max_version = std::max(m_max_version, slot.version);
+    return key_type(slot_index, slot.version);
+  }
+
+  // A reserved slot carries the version of its future key, but no element
+  constexpr key_type reserve_slot() { return allocate_slot(NULL_SLOT); }
+
+  constexpr bool is_reserved(key_type k) const noexcept {
+    if (k.slot_index >= m_slots.size()) {
+      return false;
+    }
+    auto slot = m_slots[k.slot_index];
+    return slot.version == k.version and slot.index == NULL_SLOT and
+           k.version >= m_version_floor;
+  }
+
+  template <typename... Args>
+  constexpr void emplace_reserved(key_type k, Args &&...args) {
+    assert(is_reserved(k));
+    uint32_t index = m_keys.size();
+    m_values.emplace_back(std::forward<Args>(args)...);
+    m_keys.push_back(stored_key(k));
+    m_slots[k.slot_index].index = index;
+    activate_back();
+  }
+
+  constexpr void release_reserved(key_type k) noexcept {
+    assert(is_reserved(k));
+    m_slots[k.slot_index] = {
+        .next_free = std::exchange(m_free_head, k.slot_index),
+        .version = k.version + 1,
+    };
+  }
+
+  constexpr bool is_live_slot(uint32_t slot_index) const noexcept {
+    auto index = m_slots[slot_index].index;
+    return index < m_keys.size() and slot_at(index) == slot_index;
+  }
+
+  constexpr uint32_t slot_at(uint32_t index) const noexcept {
+    if constexpr (STORE_KEYS) {
+      return m_keys[index].slot_index;
+    } else {
+      return m_keys[index];
+    }
+  }
+
+  constexpr key_type key_at(uint32_t index) const noexcept {
+    if constexpr (STORE_KEYS) {
+      return m_keys[index];
+    } else {
+      return key_type(m_keys[index], m_slots[m_keys[index]].version);
+    }
+  }
+
+  static constexpr auto stored_key(key_type k) noexcept {
+    if constexpr (STORE_KEYS) {
+      return k;
+    } else {
+      return k.slot_index;
+    }
+  }
+
+  // A key of other can be kept if its slot is unused here and reusing it
+  // does not bring back stale keys of this map
+  constexpr bool can_preserve_keys(const DenseSlotMap &other) const noexcept {
+    return std::ranges::all_of(other.keys(), [&](key_type k) {
+      return k.version >= m_version_floor and
+             (k.slot_index >= m_slots.size() or
+              (not is_live_slot(k.slot_index) and
+               m_slots[k.slot_index].version <= k.version));
+    });
+  }
+
+  constexpr void rebuild_free_list() noexcept {
+    m_free_head = NULL_SLOT;
+    m_lazy_free = 0;
+    for (uint32_t slot_index = m_slots.size(); slot_index-- > 0;) {
+      if (not is_live_slot(slot_index)) {
+        m_slots[slot_index].next_free =
+            std::exchange(m_free_head, slot_index);
+      }
+    }
+  }
+
+  constexpr size_type recycle_capacity() const noexcept {
+    if constexpr (requires { m_recycled.capacity(); }) {
+      return m_recycled.capacity();
+    } else {
+      return 0;
+    }
+  }
+
+  constexpr void prefetch_slot(key_type k) const noexcept {
+    if (k.slot_index < m_slots.size()) {
+      detail::prefetch(&m_slots[k.slot_index]);
+    }
+  }
+
+  // Prefetch the key and value that find_index(k) reads after the slot, so
+  // should be called once the slot is cached
+  constexpr void prefetch_element(key_type k) const noexcept {
+    if (k.slot_index < m_slots.size()) {
+      auto index = m_slots[k.slot_index].index;
+      if (index < m_keys.size()) {
+        detail::prefetch(&m_keys[index]);
+        detail::prefetch(&m_values[index]);
+      }
+    }
+  }
+
   constexpr uint32_t index(key_type k) const noexcept {
     assert(k.slot_index < m_slots.size());
     auto slot = m_slots[k.slot_index];
@@ -685,31 +1394,254 @@ private:
 
   constexpr void erase(uint32_t index) noexcept {
     assert(index < size());
+    index = deactivate(index);
     // Erase object from object array
     std::ranges::swap(m_values[index], m_values.back());
-    m_values.pop_back();
+    pop_back_value();
     erase_only_key(index);
   }
 
+  // Park the back value for reuse if there is room reserved for it
+  constexpr void pop_back_value() noexcept {
+    if constexpr (std::is_nothrow_move_constructible_v<value_type> and
+                  requires { m_recycled.capacity(); }) {
+      if (m_recycled.size() < m_recycled.capacity()) {
+        m_recycled.push_back(std::move(m_values.back()));
+      }
+    }
+    m_values.pop_back();
+  }
+
+  // Move the element at index to the front of the inactive partition and
+  // return its new index
+  constexpr uint32_t deactivate(uint32_t index) noexcept {
+    if (index < m_active_end) {
+      m_active_end = m_active_end - 1;
+      swap_dense(index, m_active_end);
+      return m_active_end;
+    }
+    return index;
+  }
+
+  // Move the element just appended to the back into the active partition and
+  // return its new index
+  constexpr uint32_t activate_back() noexcept {
+    uint32_t index = m_active_end;
+    swap_dense(static_cast<uint32_t>(size() - 1), index);
+    m_active_end = index + 1;
+    return index;
+  }
+
+  constexpr auto active_values_end() const noexcept {
+    return std::ranges::next(values().begin(), m_active_end);
+  }
+
+  constexpr auto active_values_end() noexcept {
+    return std::ranges::next(values().begin(), m_active_end);
+  }
+
+  constexpr void swap_dense(uint32_t i, uint32_t j) noexcept {
+    if (i == j) {
+      return;
+    }
+    std::ranges::swap(m_values[i], m_values[j]);
+    std::ranges::swap(m_keys[i], m_keys[j]);
+    m_slots[slot_at(i)].index = i;
+    m_slots[slot_at(j)].index = j;
+  }
+
+  // The version of a live element is that of its slot, so the erased key's
+  // version is taken from the slot rather than from the key array
   constexpr void erase_only_key(uint32_t index) noexcept {
-    auto back_key = m_keys.back();
-    auto erase_key = std::exchange(m_keys[index], back_key);
+    auto back_slot_index = slot_at(m_keys.size() - 1);
+    auto erase_slot_index = slot_at(index);
+    m_keys[index] = m_keys.back();
     m_keys.pop_back();
-    // Order important for back_key = erase_key
-    auto &back_slot = m_slots[back_key.slot_index];
-    auto &erase_slot = m_slots[erase_key.slot_index];
+    // Order important for back_slot_index = erase_slot_index
+    auto &back_slot = m_slots[back_slot_index];
+    auto &erase_slot = m_slots[erase_slot_index];
     back_slot.index = index;
     erase_slot = {
-        .next_free = std::exchange(m_free_head, erase_key.slot_index),
-        .version = erase_key.version + 1,
+        .next_free = std::exchange(m_free_head, erase_slot_index),
+        .version = erase_slot.version + 1,
     };
   }
 };
 
-template <typename T, CSlotMapKey K, template <typename> typename C>
-constexpr void swap(DenseSlotMap<T, K, C> &l,
-                    DenseSlotMap<T, K, C> &r) noexcept {
+template <typename T, CSlotMapKey K, template <typename> typename C,
+          KeyStorage S>
+constexpr void swap(DenseSlotMap<T, K, C, S> &l,
+                    DenseSlotMap<T, K, C, S> &r) noexcept {
   l.swap(r);
 }
 
+namespace detail {
+template <typename M> constexpr bool IsDenseSlotMap = false;
+
+template <typename T, CSlotMapKey K, template <typename> typename C,
+          KeyStorage S>
+constexpr bool IsDenseSlotMap<DenseSlotMap<T, K, C, S>> = true;
+} // namespace detail
+
+// Iterates over the keys present in every one of the joined maps. The smallest
+// map drives the iteration and the others are probed by key. Their slots are
+// prefetched two distances ahead of the probe, and the keys and values the
+// slots point to one distance ahead. Each step dispatches once on the driver
+// to a probe loop specialized for it.
+template <typename... Maps> class JoinView {
+  static_assert(sizeof...(Maps) > 0);
+  static_assert((detail::IsDenseSlotMap<std::remove_const_t<Maps>> and ...));
+
+  static constexpr size_t NUM_MAPS = sizeof...(Maps);
+  static constexpr size_t PREFETCH_DISTANCE = 8;
+  static constexpr auto NULL_SLOT = std::numeric_limits<uint32_t>::max();
+
+  std::tuple<Maps *...> m_maps;
+  size_t m_driver = 0;
+
+public:
+  using key_type =
+      std::common_type_t<typename std::remove_const_t<Maps>::key_type...>;
+  static_assert(
+      (std::same_as<key_type, typename std::remove_const_t<Maps>::key_type> and
+       ...));
+
+  using reference =
+      std::tuple<key_type, decltype(std::declval<Maps &>().values()[0])...>;
+
+  class iterator {
+    friend class JoinView;
+
+    const JoinView *m_view = nullptr;
+    size_t m_pos = 0;
+    size_t m_size = 0;
+    key_type m_key;
+    std::array<uint32_t, NUM_MAPS> m_indices;
+
+    constexpr iterator(const JoinView &view) noexcept
+        : m_view{&view}, m_size{view.driver_size()} {
+      settle();
+    }
+
+    // Advance to the first position at or after m_pos whose key is present in
+    // every map, in the loop specialized for the driver
+    constexpr void settle() noexcept {
+      [&]<size_t... I>(std::index_sequence<I...>) {
+        ((I == m_view->m_driver ? settle<I>() : void()), ...);
+      }(std::index_sequence_for<Maps...>{});
+    }
+
+    template <size_t D> constexpr void settle() noexcept {
+      decltype(auto) keys = std::get<D>(m_view->m_maps)->keys();
+      for (; m_pos < m_size; ++m_pos) {
+        if (m_pos + 2 * PREFETCH_DISTANCE < m_size) {
+          m_view->template prefetch<D>(keys[m_pos + 2 * PREFETCH_DISTANCE],
+                                       false);
+        }
+        if (m_pos + PREFETCH_DISTANCE < m_size) {
+          m_view->template prefetch<D>(keys[m_pos + PREFETCH_DISTANCE], true);
+        }
+        m_key = keys[m_pos];
+        if (m_view->template probe<D>(m_key, m_pos, m_indices)) {
+          return;
+        }
+      }
+    }
+
+  public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = reference;
+
+    iterator() = default;
+
+    constexpr reference operator*() const noexcept {
+      return [&]<size_t... I>(std::index_sequence<I...>) {
+        return reference(
+            m_key, std::get<I>(m_view->m_maps)->values()[m_indices[I]]...);
+      }(std::index_sequence_for<Maps...>{});
+    }
+
+    constexpr iterator &operator++() noexcept {
+      assert(m_pos < m_size);
+      ++m_pos;
+      settle();
+      return *this;
+    }
+
+    constexpr void operator++(int) noexcept { ++(*this); }
+
+    constexpr bool operator==(std::default_sentinel_t) const noexcept {
+      return m_pos == m_size;
+    }
+  };
+
+  constexpr explicit JoinView(Maps &...maps) noexcept : m_maps{&maps...} {
+    size_t min_size = std::numeric_limits<size_t>::max();
+    size_t i = 0;
+    ((maps.size() < min_size ? (min_size = maps.size(), m_driver = i++)
+                             : i++),
+     ...);
+  }
+
+  constexpr iterator begin() const noexcept { return iterator(*this); }
+
+  constexpr std::default_sentinel_t end() const noexcept { return {}; }
+
+private:
+  constexpr size_t driver_size() const noexcept {
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+      size_t size = 0;
+      ((I == m_driver ? (size = std::get<I>(m_maps)->size(), true) : false) or
+       ...);
+      return size;
+    }(std::index_sequence_for<Maps...>{});
+  }
+
+  // Prefetch the slots of key in the probed maps, or the keys and values
+  // they point to
+  template <size_t D>
+  constexpr void prefetch(key_type key, bool elements) const noexcept {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      (prefetch_one<I, D>(key, elements), ...);
+    }(std::index_sequence_for<Maps...>{});
+  }
+
+  template <size_t I, size_t D>
+  constexpr void prefetch_one(key_type key, bool elements) const noexcept {
+    if constexpr (I != D) {
+      if (elements) {
+        std::get<I>(m_maps)->prefetch_element(key);
+      } else {
+        std::get<I>(m_maps)->prefetch_slot(key);
+      }
+    }
+  }
+
+  template <size_t D>
+  constexpr bool probe(key_type key, size_t pos,
+                       std::array<uint32_t, NUM_MAPS> &indices) const noexcept {
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+      return (probe_one<I, D>(key, pos, indices[I]) and ...);
+    }(std::index_sequence_for<Maps...>{});
+  }
+
+  template <size_t I, size_t D>
+  constexpr bool probe_one(key_type key, size_t pos,
+                           uint32_t &index) const noexcept {
+    if constexpr (I == D) {
+      index = static_cast<uint32_t>(pos);
+      return true;
+    } else {
+      index = std::get<I>(m_maps)->find_index(key);
+      return index != NULL_SLOT;
+    }
+  }
+};
+
+template <typename... Maps>
+  requires(detail::IsDenseSlotMap<std::remove_const_t<Maps>> and ...)
+constexpr JoinView<Maps...> join(Maps &...maps) noexcept {
+  return JoinView<Maps...>(maps...);
+}
+
 } // namespace Attractadore
@@ -0,0 +1,298 @@
+#pragma once
+#include "DenseSlotMap.hpp"
+
+#include <functional>
+#include <map>
+#include <ranges>
+#include <unordered_map>
+
+namespace Attractadore {
+
+// Secondary index from Proj(value) to key, backed by a hash table
+template <auto Proj> class HashIndex {
+public:
+  template <typename T>
+  using attribute_t =
+      std::remove_cvref_t<std::invoke_result_t<decltype(Proj), const T &>>;
+
+private:
+  template <typename T, typename K>
+  using Table = std::unordered_multimap<attribute_t<T>, K>;
+
+public:
+  template <typename T, typename K> class Storage {
+    template <typename Map, typename... Indexes> friend class IndexedSlotMap;
+
+    Table<T, K> m_table;
+
+    void insert(const T &value, K key) {
+      m_table.emplace(std::invoke(Proj, value), key);
+    }
+
+    void erase(const T &value, K key) noexcept {
+      auto [first, last] = m_table.equal_range(std::invoke(Proj, value));
+      auto it = std::ranges::find(first, last, key, [](const auto &kv) {
+        return kv.second;
+      });
+      assert(it != last);
+      m_table.erase(it);
+    }
+
+    void clear() noexcept { m_table.clear(); }
+
+  public:
+    using key_type = K;
+    using attribute_type = attribute_t<T>;
+
+    // Returns some key whose element has attribute attr, or a null key
+    key_type find(const attribute_type &attr) const {
+      auto it = m_table.find(attr);
+      return it != m_table.end() ? it->second : key_type();
+    }
+
+    auto equal_range(const attribute_type &attr) const {
+      auto [first, last] = m_table.equal_range(attr);
+      return std::ranges::subrange(first, last) | std::views::values;
+    }
+
+    size_t count(const attribute_type &attr) const {
+      return m_table.count(attr);
+    }
+
+    bool contains(const attribute_type &attr) const {
+      return m_table.contains(attr);
+    }
+  };
+};
+
+// Secondary index from Proj(value) to key, kept sorted by attribute
+template <auto Proj> class SortedIndex {
+public:
+  template <typename T>
+  using attribute_t =
+      std::remove_cvref_t<std::invoke_result_t<decltype(Proj), const T &>>;
+
+  template <typename T, typename K> class Storage {
+    template <typename Map, typename... Indexes> friend class IndexedSlotMap;
+
+    std::multimap<attribute_t<T>, K, std::less<>> m_table;
+
+    void insert(const T &value, K key) {
+      m_table.emplace(std::invoke(Proj, value), key);
+    }
+
+    void erase(const T &value, K key) noexcept {
+      auto [first, last] = m_table.equal_range(std::invoke(Proj, value));
+      auto it = std::ranges::find(first, last, key, [](const auto &kv) {
+        return kv.second;
+      });
+      assert(it != last);
+      m_table.erase(it);
+    }
+
+    void clear() noexcept { m_table.clear(); }
+
+  public:
+    using key_type = K;
+    using attribute_type = attribute_t<T>;
+
+    key_type find(const attribute_type &attr) const {
+      auto it = m_table.find(attr);
+      return it != m_table.end() ? it->second : key_type();
+    }
+
+    auto equal_range(const attribute_type &attr) const {
+      auto [first, last] = m_table.equal_range(attr);
+      return std::ranges::subrange(first, last) | std::views::values;
+    }
+
+    // Keys of elements with attributes in [lo, hi), in attribute order
+    auto range(const attribute_type &lo, const attribute_type &hi) const {
+      return std::ranges::subrange(m_table.lower_bound(lo),
+                                   m_table.lower_bound(hi)) |
+             std::views::values;
+    }
+
+    size_t count(const attribute_type &attr) const {
+      return m_table.count(attr);
+    }
+
+    bool contains(const attribute_type &attr) const {
+      return m_table.contains(attr);
+    }
+  };
+};
+
+// DenseSlotMap with secondary indexes that are kept up to date by every
+// mutating operation. Values can only be mutated through modify(), so the
+// indexes never go stale.
+template <typename Map, typename... Indexes> class IndexedSlotMap {
+  static_assert(detail::IsDenseSlotMap<Map>);
+
+public:
+  using key_type = typename Map::key_type;
+  using value_type = typename Map::value_type;
+  using const_iterator = typename Map::const_iterator;
+  using const_reference = typename Map::const_reference;
+  using difference_type = typename Map::difference_type;
+  using size_type = typename Map::size_type;
+
+private:
+  Map m_map;
+  std::tuple<typename Indexes::template Storage<value_type, key_type>...>
+      m_indexes;
+
+public:
+  constexpr const Map &map() const noexcept { return m_map; }
+
+  constexpr decltype(auto) keys() const noexcept { return m_map.keys(); }
+
+  constexpr const auto &values() const noexcept { return m_map.values(); }
+
+  constexpr const_iterator cbegin() const noexcept { return begin(); }
+
+  constexpr const_iterator cend() const noexcept { return end(); }
+
+  constexpr const_iterator begin() const noexcept { return m_map.begin(); }
+
+  constexpr const_iterator end() const noexcept { return m_map.end(); }
+
+  constexpr bool empty() const noexcept { return m_map.empty(); }
+
+  constexpr size_type size() const noexcept { return m_map.size(); }
+
+  template <size_t I> constexpr const auto &index() const noexcept {
+    return std::get<I>(m_indexes);
+  }
+
+  constexpr void reserve(size_type capacity) { m_map.reserve(capacity); }
+
+  constexpr void clear() noexcept {
+    std::apply([](auto &...indexes) { (indexes.clear(), ...); }, m_indexes);
+    m_map.clear();
+  }
+
+  [[nodiscard]] constexpr key_type insert(const value_type &value)
+    requires std::copy_constructible<value_type>
+  {
+    return emplace(value)->first;
+  }
+
+  [[nodiscard]] constexpr key_type insert(value_type &&value)
+    requires std::move_constructible<value_type>
+  {
+    return emplace(std::move(value))->first;
+  }
+
+  template <typename... Args>
+    requires std::constructible_from<value_type, Args &&...>
+  [[nodiscard]] constexpr const_iterator emplace(Args &&...args) {
+    auto it = m_map.emplace(std::forward<Args>(args)...);
+    try {
+      index_insert(it->first, it->second);
+    } catch (...) {
+      m_map.erase(it->first);
+      throw;
+    }
+    auto index = std::ranges::distance(m_map.begin(), it);
+    return std::ranges::next(cbegin(), index);
+  }
+
+  constexpr void erase(key_type k) noexcept {
+    index_erase(k, m_map[k]);
+    m_map.erase(k);
+  }
+
+  [[nodiscard]] constexpr bool try_erase(key_type k) noexcept {
+    if (m_map.contains(k)) {
+      erase(k);
+      return true;
+    }
+    return false;
+  }
+
+  [[nodiscard]] constexpr value_type pop(key_type k) noexcept {
+    index_erase(k, m_map[k]);
+    return m_map.pop(k);
+  }
+
+  [[nodiscard]] constexpr std::optional<value_type>
+  try_pop(key_type k) noexcept {
+    if (m_map.contains(k)) {
+      return pop(k);
+    }
+    return std::nullopt;
+  }
+
+  // Call f with a mutable reference to the value and reindex it afterwards.
+  // If f throws, the value it left behind is reindexed. If reindexing throws,
+  // the element is erased.
+  template <std::invocable<value_type &> F>
+  constexpr decltype(auto) modify(key_type k, F &&f) {
+    auto &value = m_map[k];
+    index_erase(k, value);
+    auto call = [&]() -> decltype(auto) {
+      try {
+        return std::invoke(std::forward<F>(f), value);
+      } catch (...) {
+        reindex(k);
+        throw;
+      }
+    };
+    if constexpr (std::is_void_v<std::invoke_result_t<F, value_type &>>) {
+      call();
+      reindex(k);
+    } else {
+      decltype(auto) result = call();
+      reindex(k);
+      return result;
+    }
+  }
+
+  constexpr const_iterator find(key_type k) const noexcept {
+    return m_map.find(k);
+  }
+
+  constexpr const value_type *get(key_type k) const noexcept {
+    return m_map.get(k);
+  }
+
+  constexpr const value_type &operator[](key_type k) const noexcept {
+    return m_map[k];
+  }
+
+  constexpr bool contains(key_type k) const noexcept {
+    return m_map.contains(k);
+  }
+
+private:
+  // If an index throws, the indexes inserted into before it are rolled back
+  constexpr void index_insert(key_type k, const value_type &value) {
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      size_t inserted = 0;
+      try {
+        ((std::get<I>(m_indexes).insert(value, k), inserted++), ...);
+      } catch (...) {
+        ((I < inserted ? std::get<I>(m_indexes).erase(value, k) : void()),
+         ...);
+        throw;
+      }
+    }(std::index_sequence_for<Indexes...>{});
+  }
+
+  constexpr void reindex(key_type k) {
+    try {
+      index_insert(k, m_map[k]);
+    } catch (...) {
+      m_map.erase(k);
+      throw;
+    }
+  }
+
+  constexpr void index_erase(key_type k, const value_type &value) noexcept {
+    std::apply([&](auto &...indexes) { (indexes.erase(value, k), ...); },
+               m_indexes);
+  }
+};
+
+} // namespace Attractadore
@@ -0,0 +1,420 @@
+#pragma once
+#include "DenseSlotMap.hpp"
+
+namespace Attractadore {
+namespace detail {
+
+class AttachedStoreBase {
+  template <CSlotMapKey K, template <typename> typename C>
+  friend class ::Attractadore::KeyRegistry;
+
+protected:
+  ~AttachedStoreBase() = default;
+
+  virtual void on_destroy(uint32_t slot_index) noexcept = 0;
+  virtual void on_clear() noexcept = 0;
+  virtual void on_registry_destroy() noexcept = 0;
+};
+
+} // namespace detail
+
+// Owns the slots, versions and free list of a key space that is shared by any
+// number of AttachedStores. Destroying a key erases it from every attached
+// store. Stores that outlive the registry are cleared and detached.
+template <CSlotMapKey K, template <typename> typename C> class KeyRegistry {
+  template <typename T, CSlotMapKey K2, template <typename> typename C2>
+  friend class AttachedStore;
+
+  static constexpr auto NULL_SLOT = std::numeric_limits<uint32_t>::max();
+  static constexpr auto LIVE_SLOT = NULL_SLOT - 1;
+
+  struct Slot {
+    uint32_t next_free;
+    uint32_t version;
+  };
+
+  using Slots = C<Slot>;
+
+  Slots m_slots;
+  uint32_t m_free_head = NULL_SLOT;
+  uint32_t m_size = 0;
+  std::vector<detail::AttachedStoreBase *> m_stores;
+
+public:
+  using key_type = K;
+  using size_type = size_t;
+
+  KeyRegistry() = default;
+  KeyRegistry(const KeyRegistry &) = delete;
+  KeyRegistry &operator=(const KeyRegistry &) = delete;
+
+  ~KeyRegistry() {
+    for (auto *store : m_stores) {
+      store->on_registry_destroy();
+    }
+  }
+
+  constexpr bool empty() const noexcept { return m_size == 0; }
+
+  constexpr size_type size() const noexcept { return m_size; }
+
+  static constexpr size_type max_size() noexcept { return LIVE_SLOT - 1; }
+
+  [[nodiscard]] constexpr key_type create() {
+    if (m_free_head == NULL_SLOT) {
+      uint32_t slot_index = m_slots.size();
+      m_slots.push_back({.next_free = LIVE_SLOT, .version = 0});
+      m_size++;
+      return key_type(slot_index);
+    }
+    uint32_t slot_index = m_free_head;
+    auto &slot = m_slots[slot_index];
+    m_free_head = std::exchange(slot.next_free, LIVE_SLOT);
+    m_size++;
+    return key_type(slot_index, slot.version);
+  }
+
+  constexpr void destroy(key_type k) noexcept {
+    assert(contains(k));
+    for (auto *store : m_stores) {
+      store->on_destroy(k.slot_index);
+    }
+    m_slots[k.slot_index] = {
+        .next_free = std::exchange(m_free_head, k.slot_index),
+        .version = k.version + 1,
+    };
+    m_size--;
+  }
+
+  [[nodiscard]] constexpr bool try_destroy(key_type k) noexcept {
+    if (contains(k)) {
+      destroy(k);
+      return true;
+    }
+    return false;
+  }
+
+  constexpr void clear() noexcept {
+    for (auto *store : m_stores) {
+      store->on_clear();
+    }
+    for (uint32_t slot_index = 0; slot_index < m_slots.size(); slot_index++) {
+      auto &slot = m_slots[slot_index];
+      if (slot.next_free == LIVE_SLOT) {
+        slot = {
+            .next_free = std::exchange(m_free_head, slot_index),
+            .version = slot.version + 1,
+        };
+      }
+    }
+    m_size = 0;
+  }
+
+  constexpr bool contains(key_type k) const noexcept {
+    if (k.slot_index >= m_slots.size()) {
+      return false;
+    }
+    auto slot = m_slots[k.slot_index];
+    return slot.next_free == LIVE_SLOT and slot.version == k.version;
+  }
+
+private:
+  constexpr void attach(detail::AttachedStoreBase *store) {
+    m_stores.push_back(store);
+  }
+
+  constexpr void detach(detail::AttachedStoreBase *store) noexcept {
+    auto it = std::ranges::find(m_stores, store);
+    assert(it != m_stores.end());
+    m_stores.erase(it);
+  }
+};
+
+// Dense value array indexed by the keys of a KeyRegistry. Only slot indices
+// are kept per store; versions are checked by the registry, and keys are
+// rebuilt from the registry's versions.
+template <typename T, CSlotMapKey K, template <typename> typename C>
+class AttachedStore : private detail::AttachedStoreBase {
+  static constexpr auto NULL_SLOT = std::numeric_limits<uint32_t>::max();
+
+  using Registry = KeyRegistry<K, C>;
+  using Keys = C<uint32_t>;
+  using Values = C<T>;
+  using Sparse = C<uint32_t>;
+  using ValueView = detail::ContainerView<Values>;
+
+  // Null once the registry is destroyed
+  Registry *m_registry;
+  // Slot index of each element
+  Keys m_keys;
+  Values m_values;
+  Sparse m_sparse;
+
+  // Builds keys from the stored slot indices and the registry's versions
+  class KeyIterator {
+    friend class AttachedStore;
+
+    using Base = typename Keys::const_iterator;
+
+    Base m_it = {};
+    const Registry *m_registry = nullptr;
+
+    constexpr KeyIterator(Base it, const Registry *registry) noexcept
+        : m_it{it}, m_registry{registry} {}
+
+  public:
+    using iterator_concept = std::random_access_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = K;
+    using difference_type = std::iter_difference_t<Base>;
+    using reference = K;
+
+    KeyIterator() = default;
+
+    constexpr K operator*() const noexcept {
+      auto slot_index = *m_it;
+      return K(slot_index, m_registry->m_slots[slot_index].version);
+    }
+
+    constexpr K operator[](difference_type d) const noexcept {
+      return *(*this + d);
+    }
+
+    constexpr KeyIterator &operator++() noexcept {
+      ++m_it;
+      return *this;
+    }
+
+    constexpr KeyIterator operator++(int) noexcept {
+      auto temp = *this;
+      ++m_it;
+      return temp;
+    }
+
+    constexpr KeyIterator &operator--() noexcept {
+      --m_it;
+      return *this;
+    }
+
+    constexpr KeyIterator operator--(int) noexcept {
+      auto temp = *this;
+      --m_it;
+      return temp;
+    }
+
+    constexpr KeyIterator &operator+=(difference_type d) noexcept {
+      m_it += d;
+      return *this;
+    }
+
+    constexpr KeyIterator &operator-=(difference_type d) noexcept {
+      m_it -= d;
+      return *this;
+    }
+
+    constexpr KeyIterator operator+(difference_type d) const noexcept {
+      return {m_it + d, m_registry};
+    }
+
+    friend constexpr KeyIterator operator+(difference_type d,
+                                           KeyIterator it) noexcept {
+      return it + d;
+    }
+
+    constexpr KeyIterator operator-(difference_type d) const noexcept {
+      return {m_it - d, m_registry};
+    }
+
+    constexpr difference_type
+    operator-(const KeyIterator &other) const noexcept {
+      return m_it - other.m_it;
+    }
+
+    constexpr bool operator==(const KeyIterator &other) const noexcept {
+      return m_it == other.m_it;
+    }
+
+    constexpr auto operator<=>(const KeyIterator &other) const noexcept {
+      return m_it <=> other.m_it;
+    }
+  };
+
+  using const_key_iterator = KeyIterator;
+  using const_value_iterator = typename ValueView::const_iterator;
+  using value_iterator = typename ValueView::iterator;
+
+public:
+  using key_type = K;
+  using value_type = T;
+  using const_iterator =
+      detail::ZipIterator<const_key_iterator, const_value_iterator>;
+  using iterator = detail::ZipIterator<const_key_iterator, value_iterator>;
+  using const_reference = typename const_iterator::reference;
+  using reference = typename iterator::reference;
+  using difference_type = std::iter_difference_t<iterator>;
+  using size_type = std::make_unsigned_t<difference_type>;
+
+  explicit AttachedStore(Registry &registry) : m_registry{&registry} {
+    m_registry->attach(this);
+  }
+
+  AttachedStore(const AttachedStore &) = delete;
+  AttachedStore &operator=(const AttachedStore &) = delete;
+
+  ~AttachedStore() {
+    if (m_registry) {
+      m_registry->detach(this);
+    }
+  }
+
+  constexpr auto keys() const noexcept {
+    return std::ranges::subrange(KeyIterator(m_keys.begin(), m_registry),
+                                 KeyIterator(m_keys.end(), m_registry));
+  }
+
+  constexpr const auto &values() const noexcept {
+    return static_cast<const ValueView &>(m_values);
+  }
+
+  constexpr auto &values() noexcept {
+    return static_cast<ValueView &>(m_values);
+  }
+
+  constexpr const_iterator cbegin() const noexcept { return begin(); }
+
+  constexpr const_iterator cend() const noexcept { return end(); }
+
+  constexpr const_iterator begin() const noexcept {
+    return {keys().begin(), values().begin()};
+  }
+
+  constexpr const_iterator end() const noexcept {
+    return {keys().end(), values().end()};
+  }
+
+  constexpr iterator begin() noexcept {
+    return {keys().begin(), values().begin()};
+  }
+
+  constexpr iterator end() noexcept { return {keys().end(), values().end()}; }
+
+  constexpr bool empty() const noexcept { return begin() == end(); }
+
+  constexpr size_type size() const noexcept {
+    return static_cast<size_type>(std::ranges::distance(begin(), end()));
+  }
+
+  constexpr void clear() noexcept {
+    for (auto slot_index : m_keys) {
+      m_sparse[slot_index] = NULL_SLOT;
+    }
+    m_keys.clear();
+    m_values.clear();
+  }
+
+  template <typename... Args>
+    requires std::constructible_from<value_type, Args &&...>
+  constexpr iterator emplace(key_type k, Args &&...args) {
+    assert(m_registry and m_registry->contains(k));
+    assert(not contains(k));
+    if (k.slot_index >= m_sparse.size()) {
+      m_sparse.resize(k.slot_index + 1, NULL_SLOT);
+    }
+    uint32_t index = m_keys.size();
+    m_keys.push_back(k.slot_index);
+    m_values.emplace_back(std::forward<Args>(args)...);
+    m_sparse[k.slot_index] = index;
+    return std::ranges::next(begin(), index);
+  }
+
+  constexpr void erase(key_type k) noexcept {
+    assert(contains(k));
+    erase_slot(k.slot_index);
+  }
+
+  [[nodiscard]] constexpr bool try_erase(key_type k) noexcept {
+    if (contains(k)) {
+      erase_slot(k.slot_index);
+      return true;
+    }
+    return false;
+  }
+
+#define attractadore_attached_store_find(k)                                    \
+  auto dense_index = find_index(k);                                            \
+  if (dense_index != NULL_SLOT) {                                              \
+    return std::ranges::next(begin(), dense_index);                            \
+  }                                                                            \
+  return end();
+
+  constexpr const_iterator find(key_type k) const noexcept {
+    attractadore_attached_store_find(k);
+  }
+
+  constexpr iterator find(key_type k) noexcept {
+    attractadore_attached_store_find(k);
+  }
+
+#undef attractadore_attached_store_find
+
+  constexpr const value_type *get(key_type k) const noexcept {
+    auto dense_index = find_index(k);
+    return dense_index != NULL_SLOT ? &m_values[dense_index] : nullptr;
+  }
+
+  constexpr value_type *get(key_type k) noexcept {
+    auto dense_index = find_index(k);
+    return dense_index != NULL_SLOT ? &m_values[dense_index] : nullptr;
+  }
+
+  constexpr const value_type &operator[](key_type k) const noexcept {
+    assert(contains(k));
+    return m_values[m_sparse[k.slot_index]];
+  }
+
+  constexpr value_type &operator[](key_type k) noexcept {
+    assert(contains(k));
+    return m_values[m_sparse[k.slot_index]];
+  }
+
+  constexpr bool contains(key_type k) const noexcept {
+    return find_index(k) != NULL_SLOT;
+  }
+
+private:
+  constexpr uint32_t find_index(key_type k) const noexcept {
+    if (not m_registry or not m_registry->contains(k) or
+        k.slot_index >= m_sparse.size()) {
+      return NULL_SLOT;
+    }
+    return m_sparse[k.slot_index];
+  }
+
+  constexpr void erase_slot(uint32_t slot_index) noexcept {
+    auto index = std::exchange(m_sparse[slot_index], NULL_SLOT);
+    assert(index < m_values.size());
+    std::ranges::swap(m_values[index], m_values.back());
+    m_values.pop_back();
+    auto back_slot_index = m_keys.back();
+    m_keys[index] = back_slot_index;
+    m_keys.pop_back();
+    if (back_slot_index != slot_index) {
+      m_sparse[back_slot_index] = index;
+    }
+  }
+
+  void on_destroy(uint32_t slot_index) noexcept override {
+    if (slot_index < m_sparse.size() and m_sparse[slot_index] != NULL_SLOT) {
+      erase_slot(slot_index);
+    }
+  }
+
+  void on_clear() noexcept override { clear(); }
+
+  void on_registry_destroy() noexcept override {
+    clear();
+    m_registry = nullptr;
+  }
+};
+
+} // namespace Attractadore
@@ -0,0 +1,339 @@
+#pragma once
+#include "DenseSlotMap.hpp"
+
+namespace Attractadore {
+namespace detail {
+
+template <typename T, typename... Ts> constexpr uint32_t TypeIndex = 0;
+
+template <typename T, typename U, typename... Ts>
+constexpr uint32_t TypeIndex<T, U, Ts...> =
+    std::same_as<T, U> ? 0 : 1 + TypeIndex<T, Ts...>;
+
+template <typename T, typename... Ts>
+concept COneOf = (std::same_as<T, Ts> or ...);
+
+} // namespace detail
+
+// Slot map over a closed set of types derived from Base. All types share one
+// key space, but each type is stored contiguously in its own dense array, so
+// visit() updates objects type by type without virtual calls.
+template <CSlotMapKey K, template <typename> typename C, typename Base,
+          typename... Derived>
+class BasicPolySlotMap {
+  static_assert(sizeof...(Derived) > 0);
+  static_assert((std::derived_from<Derived, Base> and ...));
+
+  static constexpr auto NULL_SLOT = std::numeric_limits<uint32_t>::max();
+
+  struct Slot {
+    union {
+      uint32_t index;
+      uint32_t next_free;
+    };
+    uint32_t version;
+    uint32_t type;
+  };
+
+  template <typename D> struct Store {
+    C<K> keys;
+    C<D> values;
+  };
+
+  using Slots = C<Slot>;
+
+  std::tuple<Store<Derived>...> m_stores;
+  Slots m_slots;
+  uint32_t m_free_head = NULL_SLOT;
+  uint32_t m_size = 0;
+
+  template <typename D> using KeyView = detail::ContainerView<C<K>>;
+  template <typename D> using ValueView = detail::ContainerView<C<D>>;
+
+  template <typename D>
+  static constexpr uint32_t type_index = detail::TypeIndex<D, Derived...>;
+
+public:
+  using key_type = K;
+  using size_type = size_t;
+
+  // Reference to an element whose type is only known at runtime
+  template <typename B> class BasicHandle {
+    friend class BasicPolySlotMap;
+
+    using Void = std::conditional_t<std::is_const_v<B>, const void, void>;
+
+    Void *m_ptr = nullptr;
+    uint32_t m_type = 0;
+
+    constexpr BasicHandle(Void *ptr, uint32_t type) noexcept
+        : m_ptr{ptr}, m_type{type} {}
+
+  public:
+    BasicHandle() = default;
+
+    constexpr explicit operator bool() const noexcept {
+      return m_ptr != nullptr;
+    }
+
+    constexpr uint32_t type_index() const noexcept { return m_type; }
+
+    template <detail::COneOf<Derived...> D>
+    constexpr bool holds() const noexcept {
+      return m_ptr and m_type == BasicPolySlotMap::type_index<D>;
+    }
+
+    template <detail::COneOf<Derived...> D>
+    constexpr auto *get_if() const noexcept {
+      using P = std::conditional_t<std::is_const_v<B>, const D *, D *>;
+      return holds<D>() ? static_cast<P>(m_ptr) : nullptr;
+    }
+
+    constexpr B *get() const noexcept {
+      return visit([](auto &obj) -> B * { return &obj; });
+    }
+
+    constexpr B *operator->() const noexcept { return get(); }
+
+    template <typename F> constexpr decltype(auto) visit(F &&f) const {
+      assert(m_ptr);
+      return [&]<size_t... I>(std::index_sequence<I...>) -> decltype(auto) {
+        using R = decltype(f(*get_if<std::tuple_element_t<
+                                 0, std::tuple<Derived...>>>()));
+        using Fn = R (*)(F &, Void *);
+        static constexpr Fn table[] = {+[](F &f, Void *ptr) -> R {
+          using D = std::tuple_element_t<I, std::tuple<Derived...>>;
+          using P = std::conditional_t<std::is_const_v<B>, const D *, D *>;
+          return f(*static_cast<P>(ptr));
+        }...};
+        return table[m_type](f, m_ptr);
+      }(std::index_sequence_for<Derived...>{});
+    }
+  };
+
+  using handle = BasicHandle<Base>;
+  using const_handle = BasicHandle<const Base>;
+
+  template <detail::COneOf<Derived...> D>
+  constexpr const auto &keys() const noexcept {
+    return static_cast<const KeyView<D> &>(store<D>().keys);
+  }
+
+  template <detail::COneOf<Derived...> D>
+  constexpr const auto &values() const noexcept {
+    return static_cast<const ValueView<D> &>(store<D>().values);
+  }
+
+  template <detail::COneOf<Derived...> D> constexpr auto &values() noexcept {
+    return static_cast<ValueView<D> &>(store<D>().values);
+  }
+
+  constexpr bool empty() const noexcept { return m_size == 0; }
+
+  constexpr size_type size() const noexcept { return m_size; }
+
+  static constexpr size_type max_size() noexcept { return NULL_SLOT - 1; }
+
+  constexpr void clear() noexcept {
+    (clear_store<Derived>(), ...);
+    m_size = 0;
+  }
+
+  template <detail::COneOf<Derived...> D>
+  [[nodiscard]] constexpr key_type insert(const D &value)
+    requires std::copy_constructible<D>
+  {
+    return emplace<D>(value);
+  }
+
+  template <detail::COneOf<Derived...> D>
+  [[nodiscard]] constexpr key_type insert(D &&value)
+    requires std::move_constructible<D>
+  {
+    return emplace<D>(std::move(value));
+  }
+
+  template <detail::COneOf<Derived...> D, typename... Args>
+    requires std::constructible_from<D, Args &&...>
+  [[nodiscard]] constexpr key_type emplace(Args &&...args) {
+    auto &s = store<D>();
+    uint32_t index = s.keys.size();
+    auto key = [&] {
+      if (m_free_head == NULL_SLOT) {
+        uint32_t slot_index = m_slots.size();
+        m_slots.push_back(
+            {.index = index, .version = 0, .type = type_index<D>});
+        return key_type(slot_index);
+      }
+      uint32_t slot_index = m_free_head;
+      auto &slot = m_slots[slot_index];
+      m_free_head = slot.next_free;
+      slot.index = index;
+      slot.type = type_index<D>;
+      return key_type(slot_index, slot.version);
+    }();
+    s.keys.push_back(key);
+    s.values.emplace_back(std::forward<Args>(args)...);
+    m_size++;
+    return key;
+  }
+
+  constexpr void erase(key_type k) noexcept {
+    assert(contains(k));
+    auto slot = m_slots[k.slot_index];
+    [&]<size_t... I>(std::index_sequence<I...>) {
+      ((I == slot.type
+            ? erase_from<std::tuple_element_t<I, std::tuple<Derived...>>>(
+                  slot.index)
+            : void()),
+       ...);
+    }(std::index_sequence_for<Derived...>{});
+  }
+
+  [[nodiscard]] constexpr bool try_erase(key_type k) noexcept {
+    if (contains(k)) {
+      erase(k);
+      return true;
+    }
+    return false;
+  }
+
+  constexpr bool contains(key_type k) const noexcept {
+    if (k.slot_index >= m_slots.size()) {
+      return false;
+    }
+    // A free slot already has the version of the next key it will hand out,
+    // so a key of another map can match it
+    auto slot = m_slots[k.slot_index];
+    return slot.version == k.version and is_live_slot(k.slot_index, slot);
+  }
+
+#define attractadore_poly_slotmap_find(k)                                      \
+  if (not contains(k)) {                                                       \
+    return {};                                                                 \
+  }                                                                            \
+  auto slot = m_slots[k.slot_index];                                           \
+  return [&]<size_t... I>(std::index_sequence<I...>) {                         \
+    decltype(find(k)) h;                                                       \
+    ((I == slot.type                                                           \
+          ? (h = {&values<std::tuple_element_t<I, std::tuple<Derived...>>>()   \
+                       [slot.index],                                           \
+                  slot.type},                                                  \
+             true)                                                             \
+          : false) or                                                          \
+     ...);                                                                     \
+    return h;                                                                  \
+  }(std::index_sequence_for<Derived...>{});
+
+  constexpr const_handle find(key_type k) const noexcept {
+    attractadore_poly_slotmap_find(k);
+  }
+
+  constexpr handle find(key_type k) noexcept {
+    attractadore_poly_slotmap_find(k);
+  }
+
+#undef attractadore_poly_slotmap_find
+
+  template <detail::COneOf<Derived...> D>
+  constexpr const D *get(key_type k) const noexcept {
+    return find(k).template get_if<D>();
+  }
+
+  template <detail::COneOf<Derived...> D>
+  constexpr D *get(key_type k) noexcept {
+    return find(k).template get_if<D>();
+  }
+
+  constexpr const Base *get(key_type k) const noexcept {
+    auto h = find(k);
+    return h ? h.get() : nullptr;
+  }
+
+  constexpr Base *get(key_type k) noexcept {
+    auto h = find(k);
+    return h ? h.get() : nullptr;
+  }
+
+  // Call f on every element, one type at a time
+  template <typename F> constexpr void visit(F &&f) const {
+    (std::ranges::for_each(values<Derived>(), f), ...);
+  }
+
+  template <typename F> constexpr void visit(F &&f) {
+    (std::ranges::for_each(values<Derived>(), f), ...);
+  }
+
+  constexpr void swap(BasicPolySlotMap &other) noexcept {
+    std::ranges::swap(m_stores, other.m_stores);
+    std::ranges::swap(m_slots, other.m_slots);
+    std::ranges::swap(m_free_head, other.m_free_head);
+    std::ranges::swap(m_size, other.m_size);
+  }
+
+private:
+  template <typename D> constexpr const Store<D> &store() const noexcept {
+    return std::get<type_index<D>>(m_stores);
+  }
+
+  template <typename D> constexpr Store<D> &store() noexcept {
+    return std::get<type_index<D>>(m_stores);
+  }
+
+  // Whether the element the slot points to points back to it
+  constexpr bool is_live_slot(uint32_t slot_index, Slot slot) const noexcept {
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+      return ((I == slot.type and
+               is_live_slot_in<std::tuple_element_t<I, std::tuple<Derived...>>>(
+                   slot_index, slot.index)) or
+              ...);
+    }(std::index_sequence_for<Derived...>{});
+  }
+
+  template <typename D>
+  constexpr bool is_live_slot_in(uint32_t slot_index,
+                                 uint32_t index) const noexcept {
+    const auto &keys = store<D>().keys;
+    return index < keys.size() and keys[index].slot_index == slot_index;
+  }
+
+  template <typename D> constexpr void erase_from(uint32_t index) noexcept {
+    auto &s = store<D>();
+    assert(index < s.values.size());
+    std::ranges::swap(s.values[index], s.values.back());
+    s.values.pop_back();
+    auto back_key = s.keys.back();
+    auto erase_key = std::exchange(s.keys[index], back_key);
+    s.keys.pop_back();
+    // Order important for back_key = erase_key
+    m_slots[back_key.slot_index].index = index;
+    auto &erase_slot = m_slots[erase_key.slot_index];
+    erase_slot.next_free = std::exchange(m_free_head, erase_key.slot_index);
+    erase_slot.version = erase_key.version + 1;
+    m_size--;
+  }
+
+  template <typename D> constexpr void clear_store() noexcept {
+    auto &s = store<D>();
+    for (auto [slot_index, version] : s.keys) {
+      auto &slot = m_slots[slot_index];
+      slot.next_free = std::exchange(m_free_head, slot_index);
+      slot.version = version + 1;
+    }
+    s.keys.clear();
+    s.values.clear();
+  }
+};
+
+template <typename Base, typename... Derived>
+using PolySlotMap =
+    BasicPolySlotMap<SlotMapKey, detail::StdVector, Base, Derived...>;
+
+template <CSlotMapKey K, template <typename> typename C, typename Base,
+          typename... Derived>
+constexpr void swap(BasicPolySlotMap<K, C, Base, Derived...> &l,
+                    BasicPolySlotMap<K, C, Base, Derived...> &r) noexcept {
+  l.swap(r);
+}
+
+} // namespace Attractadore
@@ -0,0 +1,498 @@
+#pragma once
+#include "DenseSlotMap.hpp"
+
+#if __has_include(<sys/mman.h>)
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Attractadore {
+namespace detail {
+
+// Spin-wait hint for the CPU
+inline void cpu_pause() noexcept {
+#if defined(__x86_64__) or defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) or defined(__arm__)
+  asm volatile("yield");
+#endif
+}
+
+// Mapping of a shared slot map region: a header followed by the slot, key and
+// value arrays at offsets that only depend on the capacity. The region holds
+// no pointers, so every process can map it at a different address.
+template <typename T, typename K> class SharedRegion {
+public:
+  static constexpr auto NULL_SLOT = std::numeric_limits<uint32_t>::max();
+  static constexpr uint64_t MAGIC = 0x50414d544f4c53; // "SLOTMAP"
+
+  struct Header {
+    uint64_t magic;
+    uint32_t capacity;
+    uint32_t value_size;
+    // Odd while the writer is modifying the region
+    std::atomic<uint64_t> sequence;
+    uint32_t size;
+    uint32_t num_slots;
+    uint32_t free_head;
+  };
+
+  struct Slot {
+    union {
+      uint32_t index;
+      uint32_t next_free;
+    };
+    uint32_t version;
+  };
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                "The sequence counter must be address free");
+
+private:
+  std::byte *m_base = nullptr;
+  size_t m_bytes = 0;
+
+  static constexpr size_t align_up(size_t n, size_t alignment) noexcept {
+    return (n + alignment - 1) / alignment * alignment;
+  }
+
+  static constexpr size_t slots_offset() noexcept {
+    return align_up(sizeof(Header), alignof(Slot));
+  }
+
+  static constexpr size_t keys_offset(uint32_t capacity) noexcept {
+    return align_up(slots_offset() + capacity * sizeof(Slot), alignof(K));
+  }
+
+  static constexpr size_t values_offset(uint32_t capacity) noexcept {
+    return align_up(keys_offset(capacity) + capacity * sizeof(K), alignof(T));
+  }
+
+public:
+  static constexpr size_t region_size(uint32_t capacity) noexcept {
+    return values_offset(capacity) + capacity * sizeof(T);
+  }
+
+  static constexpr std::pair<uint32_t, uint32_t> key_parts(K k) noexcept {
+    return DenseSlotMap<T, K>::key_parts(k);
+  }
+
+  static constexpr K make_key(uint32_t slot_index, uint32_t version) noexcept {
+    return DenseSlotMap<T, K>::make_key(slot_index, version);
+  }
+
+  SharedRegion() = default;
+
+  SharedRegion(int fd, size_t bytes, bool writable) : m_bytes{bytes} {
+    auto prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    auto *ptr = ::mmap(nullptr, bytes, prot, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+      throw std::system_error(errno, std::generic_category(), "mmap");
+    }
+    m_base = static_cast<std::byte *>(ptr);
+  }
+
+  SharedRegion(SharedRegion &&other) noexcept
+      : m_base{std::exchange(other.m_base, nullptr)},
+        m_bytes{std::exchange(other.m_bytes, 0)} {}
+
+  SharedRegion &operator=(SharedRegion &&other) noexcept {
+    std::ranges::swap(m_base, other.m_base);
+    std::ranges::swap(m_bytes, other.m_bytes);
+    return *this;
+  }
+
+  ~SharedRegion() {
+    if (m_base) {
+      ::munmap(m_base, m_bytes);
+    }
+  }
+
+  size_t bytes() const noexcept { return m_bytes; }
+
+  Header &header() const noexcept {
+    return *std::launder(reinterpret_cast<Header *>(m_base));
+  }
+
+  Slot *slots() const noexcept {
+    return reinterpret_cast<Slot *>(m_base + slots_offset());
+  }
+
+  K *keys() const noexcept {
+    return reinterpret_cast<K *>(m_base + keys_offset(header().capacity));
+  }
+
+  T *values() const noexcept {
+    return reinterpret_cast<T *>(m_base + values_offset(header().capacity));
+  }
+};
+
+} // namespace detail
+
+// Fixed capacity slot map in a shared memory object. A single writer process
+// mutates the map through SharedSlotMap while any number of reader processes
+// map the same object with SharedSlotMapReader. Writes are published through
+// a sequence lock: readers copy data out and retry if a write overlapped.
+template <typename T, CSlotMapKey K = SlotMapKey> class SharedSlotMap {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "Shared values are copied out by readers as raw bytes");
+
+  using Region = detail::SharedRegion<T, K>;
+  using Slot = typename Region::Slot;
+  static constexpr auto NULL_SLOT = Region::NULL_SLOT;
+
+  Region m_region;
+  uint32_t m_write_depth = 0;
+
+public:
+  using key_type = K;
+  using value_type = T;
+  using size_type = size_t;
+
+  // Size the shared memory object fd, which may come from shm_open() or
+  // memfd_create(), and create an empty map in it. fd is not closed.
+  SharedSlotMap(int fd, uint32_t capacity) {
+    assert(capacity < NULL_SLOT);
+    auto bytes = Region::region_size(capacity);
+    if (::ftruncate(fd, bytes) != 0) {
+      throw std::system_error(errno, std::generic_category(), "ftruncate");
+    }
+    m_region = Region(fd, bytes, true);
+    auto &h = m_region.header();
+    std::construct_at(&h);
+    h.capacity = capacity;
+    h.value_size = sizeof(T);
+    h.size = 0;
+    h.num_slots = 0;
+    h.free_head = NULL_SLOT;
+    h.sequence.store(0, std::memory_order_relaxed);
+    // Publish the magic last, so readers never accept a partial header
+    std::atomic_thread_fence(std::memory_order_release);
+    h.magic = Region::MAGIC;
+  }
+
+  // Create the POSIX shared memory object name and a map in it
+  static SharedSlotMap create(const char *name, uint32_t capacity) {
+    int fd = ::shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "shm_open");
+    }
+    struct Close {
+      int fd;
+      ~Close() { ::close(fd); }
+    } close{fd};
+    return SharedSlotMap(fd, capacity);
+  }
+
+  size_type capacity() const noexcept { return header().capacity; }
+
+  size_type size() const noexcept { return header().size; }
+
+  bool empty() const noexcept { return size() == 0; }
+
+  bool full() const noexcept { return size() == capacity(); }
+
+  std::span<const key_type> keys() const noexcept {
+    return {m_region.keys(), size()};
+  }
+
+  std::span<const value_type> values() const noexcept {
+    return {m_region.values(), size()};
+  }
+
+  bool contains(key_type k) const noexcept { return get(k) != nullptr; }
+
+  // A free slot already has the version of the next key it will hand out,
+  // so the slot is only live if its key points back to it
+  const value_type *get(key_type k) const noexcept {
+    auto slot_index = Region::key_parts(k).first;
+    if (slot_index >= header().num_slots) {
+      return nullptr;
+    }
+    auto slot = m_region.slots()[slot_index];
+    return slot.index < header().size and m_region.keys()[slot.index] == k
+               ? &m_region.values()[slot.index]
+               : nullptr;
+  }
+
+  const value_type &operator[](key_type k) const noexcept {
+    assert(contains(k));
+    return *get(k);
+  }
+
+  template <typename... Args>
+    requires std::constructible_from<value_type, Args &&...>
+  [[nodiscard]] key_type emplace(Args &&...args) {
+    assert(not full());
+    value_type value(std::forward<Args>(args)...);
+    auto write = begin_write();
+    auto &h = header();
+    auto *slots = m_region.slots();
+    uint32_t index = h.size;
+    uint32_t slot_index = h.free_head;
+    if (slot_index == NULL_SLOT) {
+      slot_index = h.num_slots++;
+      slots[slot_index].version = 0;
+    } else {
+      h.free_head = slots[slot_index].next_free;
+    }
+    slots[slot_index].index = index;
+    auto k = Region::make_key(slot_index, slots[slot_index].version);
+    m_region.keys()[index] = k;
+    std::memcpy(&m_region.values()[index], &value, sizeof(value_type));
+    h.size++;
+    return k;
+  }
+
+  [[nodiscard]] key_type insert(const value_type &value) {
+    return emplace(value);
+  }
+
+  void assign(key_type k, const value_type &value) noexcept {
+    assert(contains(k));
+    auto write = begin_write();
+    auto slot_index = Region::key_parts(k).first;
+    auto index = m_region.slots()[slot_index].index;
+    std::memcpy(&m_region.values()[index], &value, sizeof(value_type));
+  }
+
+  void erase(key_type k) noexcept {
+    assert(contains(k));
+    auto write = begin_write();
+    auto &h = header();
+    auto *slots = m_region.slots();
+    auto *keys = m_region.keys();
+    auto *values = m_region.values();
+    auto [slot_index, version] = Region::key_parts(k);
+    auto index = slots[slot_index].index;
+    auto back = h.size - 1;
+    keys[index] = keys[back];
+    std::memcpy(&values[index], &values[back], sizeof(value_type));
+    slots[Region::key_parts(keys[index]).first].index = index;
+    slots[slot_index].next_free = std::exchange(h.free_head, slot_index);
+    slots[slot_index].version = version + 1;
+    h.size--;
+  }
+
+  [[nodiscard]] bool try_erase(key_type k) noexcept {
+    if (contains(k)) {
+      erase(k);
+      return true;
+    }
+    return false;
+  }
+
+  void clear() noexcept {
+    auto write = begin_write();
+    auto &h = header();
+    for (auto k : keys()) {
+      auto [slot_index, version] = Region::key_parts(k);
+      auto &slot = m_region.slots()[slot_index];
+      slot.next_free = std::exchange(h.free_head, slot_index);
+      slot.version = version + 1;
+    }
+    h.size = 0;
+  }
+
+  // Make all modifications done by f visible to readers at once
+  template <std::invocable<SharedSlotMap &> F> decltype(auto) batch(F &&f) {
+    auto write = begin_write();
+    return std::invoke(std::forward<F>(f), *this);
+  }
+
+private:
+  class WriteGuard {
+    SharedSlotMap &m_map;
+
+  public:
+    explicit WriteGuard(SharedSlotMap &map) noexcept : m_map{map} {
+      if (m_map.m_write_depth++ == 0) {
+        auto &sequence = m_map.header().sequence;
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+      }
+    }
+
+    WriteGuard(const WriteGuard &) = delete;
+    WriteGuard &operator=(const WriteGuard &) = delete;
+
+    ~WriteGuard() {
+      if (--m_map.m_write_depth == 0) {
+        auto &sequence = m_map.header().sequence;
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_release);
+      }
+    }
+  };
+
+  [[nodiscard]] WriteGuard begin_write() noexcept { return WriteGuard(*this); }
+
+  typename Region::Header &header() const noexcept {
+    return m_region.header();
+  }
+};
+
+// Read-only view of a SharedSlotMap owned by another process. Lookups copy
+// values out and are retried until they did not overlap with a write. If the
+// writer holds the region for longer than timeout(), for example because it
+// died in the middle of a write, reads throw std::errc::timed_out.
+template <typename T, CSlotMapKey K = SlotMapKey> class SharedSlotMapReader {
+  using Region = detail::SharedRegion<T, K>;
+  using Slot = typename Region::Slot;
+
+  // Retries before the reader starts yielding and checking the clock
+  static constexpr unsigned SPIN_LIMIT = 1024;
+
+  Region m_region;
+  std::chrono::nanoseconds m_timeout = std::chrono::seconds(1);
+
+public:
+  using key_type = K;
+  using value_type = T;
+  using size_type = size_t;
+
+  // Map the shared memory object fd read-only. fd is not closed.
+  explicit SharedSlotMapReader(int fd) {
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      throw std::system_error(errno, std::generic_category(), "fstat");
+    }
+    auto bytes = static_cast<size_t>(st.st_size);
+    if (bytes < sizeof(typename Region::Header)) {
+      throw std::system_error(
+          std::make_error_code(std::errc::invalid_argument));
+    }
+    m_region = Region(fd, bytes, false);
+    const auto &h = m_region.header();
+    auto valid = h.magic == Region::MAGIC;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (not valid or h.value_size != sizeof(T) or
+        Region::region_size(h.capacity) > bytes) {
+      throw std::system_error(
+          std::make_error_code(std::errc::invalid_argument));
+    }
+  }
+
+  // Open the POSIX shared memory object name created by SharedSlotMap
+  static SharedSlotMapReader open(const char *name) {
+    int fd = ::shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "shm_open");
+    }
+    struct Close {
+      int fd;
+      ~Close() { ::close(fd); }
+    } close{fd};
+    return SharedSlotMapReader(fd);
+  }
+
+  std::chrono::nanoseconds timeout() const noexcept { return m_timeout; }
+
+  void set_timeout(std::chrono::nanoseconds timeout) noexcept {
+    m_timeout = timeout;
+  }
+
+  size_type capacity() const noexcept { return m_region.header().capacity; }
+
+  size_type size() const {
+    return read([&] { return m_region.header().size; });
+  }
+
+  bool empty() const { return size() == 0; }
+
+  std::optional<value_type> get(key_type k) const {
+    auto [slot_index, version] = Region::key_parts(k);
+    if (slot_index >= capacity()) {
+      return std::nullopt;
+    }
+    return read([&]() -> std::optional<value_type> {
+      Slot slot;
+      std::memcpy(&slot, &m_region.slots()[slot_index], sizeof(Slot));
+      // A torn slot may hold any index, so check it before using it. A free
+      // slot is told apart by its key not pointing back to it.
+      if (slot.version != version or slot.index >= capacity() or
+          slot.index >= m_region.header().size) {
+        return std::nullopt;
+      }
+      key_type slot_key;
+      std::memcpy(&slot_key, &m_region.keys()[slot.index], sizeof(key_type));
+      if (slot_key != k) {
+        return std::nullopt;
+      }
+      std::array<std::byte, sizeof(value_type)> bytes;
+      std::memcpy(bytes.data(), &m_region.values()[slot.index], bytes.size());
+      return std::bit_cast<value_type>(bytes);
+    });
+  }
+
+  bool contains(key_type k) const { return get(k).has_value(); }
+
+  // Copy out a consistent snapshot of all keys and values
+  void snapshot(std::vector<key_type> &keys,
+                std::vector<value_type> &values) const {
+    read([&] {
+      auto size = std::min<size_t>(m_region.header().size, capacity());
+      keys.resize(size);
+      values.resize(size);
+      std::memcpy(keys.data(), m_region.keys(), size * sizeof(key_type));
+      std::memcpy(values.data(), m_region.values(),
+                  size * sizeof(value_type));
+      return 0;
+    });
+  }
+
+  // Call f(key, value) on every element of a consistent snapshot
+  template <std::invocable<key_type, const value_type &> F>
+  void for_each(F &&f) const {
+    std::vector<key_type> keys;
+    std::vector<value_type> values;
+    snapshot(keys, values);
+    for (size_t i = 0; i < keys.size(); i++) {
+      std::invoke(f, keys[i], values[i]);
+    }
+  }
+
+private:
+  template <typename F> auto read(F &&f) const {
+    auto &sequence = m_region.header().sequence;
+    std::chrono::steady_clock::time_point deadline;
+    for (unsigned attempt = 0;; attempt++) {
+      auto begin = sequence.load(std::memory_order_acquire);
+      if (not(begin & 1)) {
+        auto result = f();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == begin) {
+          return result;
+        }
+      }
+      if (attempt < SPIN_LIMIT) {
+        detail::cpu_pause();
+        continue;
+      }
+      auto now = std::chrono::steady_clock::now();
+      if (attempt == SPIN_LIMIT) {
+        deadline = now + m_timeout;
+      } else if (now >= deadline) {
+        throw std::system_error(std::make_error_code(std::errc::timed_out));
+      }
+      std::this_thread::yield();
+    }
+  }
+};
+
+} // namespace Attractadore
+
+#endif
@@ -0,0 +1,186 @@
+#pragma once
+#include "DenseSlotMap.hpp"
+
+#include <cstring>
+
+namespace Attractadore {
+
+// Difference between two states of a DenseSlotMap: the keys that were erased
+// and the elements that were inserted or changed, by key. An element is
+// changed if its value or its active state differs. The delta also carries
+// the free list state of every slot that is not live and differs from the old
+// state, so applying it costs time proportional to the delta, not to the map.
+// Applying the delta of (old, new) to a map equal to old gives it new's keys,
+// values, active states and free list, so both hand out the same keys next,
+// though the order of elements in the dense arrays may differ.
+template <typename Map> class SlotMapDelta {
+  static_assert(detail::IsDenseSlotMap<Map>);
+
+public:
+  using key_type = typename Map::key_type;
+  using value_type = typename Map::value_type;
+  using size_type = size_t;
+
+  struct Entry {
+    key_type key;
+    value_type value;
+    bool active;
+  };
+
+  // Free list link, or NULL_SLOT for a reserved slot, and version of a slot
+  // that is not live in the new state
+  struct SlotRecord {
+    uint32_t slot_index;
+    uint32_t next_free;
+    uint32_t version;
+  };
+
+private:
+  std::vector<key_type> m_erased;
+  std::vector<Entry> m_inserted;
+  std::vector<Entry> m_changed;
+  std::vector<SlotRecord> m_slots;
+  uint32_t m_num_slots = 0;
+  uint32_t m_free_head = Map::NULL_SLOT;
+  uint32_t m_lazy_free = 0;
+  uint32_t m_version_floor = 0;
+  uint32_t m_max_version = 0;
+  bool m_header_changed = false;
+
+  static bool equal_values(const value_type &l, const value_type &r) noexcept {
+    if constexpr (std::is_trivially_copyable_v<value_type>) {
+      return std::memcmp(&l, &r, sizeof(value_type)) == 0;
+    } else {
+      return l == r;
+    }
+  }
+
+public:
+  // Both maps must be states of the same key space, i.e. new_map must have
+  // been derived from old_map or from a copy of it
+  static SlotMapDelta diff(const Map &old_map, const Map &new_map)
+    requires std::is_trivially_copyable_v<value_type> or
+             std::equality_comparable<value_type>
+  {
+    SlotMapDelta delta;
+    for (uint32_t i = 0; i < new_map.size(); i++) {
+      auto k = new_map.key_at(i);
+      const auto &value = new_map.m_values[i];
+      bool active = i < new_map.m_active_end;
+      auto index = old_map.find_index(k);
+      if (index == Map::NULL_SLOT) {
+        delta.m_inserted.push_back({k, value, active});
+      } else if (active != (index < old_map.m_active_end) or
+                 not equal_values(old_map.m_values[index], value)) {
+        delta.m_changed.push_back({k, value, active});
+      }
+    }
+    for (auto k : old_map.keys()) {
+      if (new_map.find_index(k) == Map::NULL_SLOT) {
+        delta.m_erased.push_back(k);
+      }
+    }
+    // Slots that were live in old_map are always recorded, since clear()
+    // frees them without changing their records
+    uint32_t num_old_slots = old_map.m_slots.size();
+    for (uint32_t slot_index = 0; slot_index < new_map.m_slots.size();
+         slot_index++) {
+      if (new_map.is_live_slot(slot_index)) {
+        continue;
+      }
+      auto slot = new_map.m_slots[slot_index];
+      if (slot_index >= num_old_slots or old_map.is_live_slot(slot_index) or
+          old_map.m_slots[slot_index].next_free != slot.next_free or
+          old_map.m_slots[slot_index].version != slot.version) {
+        delta.m_slots.push_back({slot_index, slot.next_free, slot.version});
+      }
+    }
+    delta.m_num_slots = new_map.m_slots.size();
+    delta.m_free_head = new_map.m_free_head;
+    delta.m_lazy_free = new_map.m_lazy_free;
+    delta.m_version_floor = new_map.m_version_floor;
+    delta.m_max_version = new_map.m_max_version;
+    delta.m_header_changed =
+        delta.m_num_slots != num_old_slots or
+        delta.m_free_head != old_map.m_free_head or
+        delta.m_lazy_free != old_map.m_lazy_free or
+        delta.m_version_floor != old_map.m_version_floor or
+        delta.m_max_version != old_map.m_max_version;
+    return delta;
+  }
+
+  std::span<const key_type> erased() const noexcept { return m_erased; }
+
+  std::span<const Entry> inserted() const noexcept { return m_inserted; }
+
+  std::span<const Entry> changed() const noexcept { return m_changed; }
+
+  std::span<const SlotRecord> slots() const noexcept { return m_slots; }
+
+  bool empty() const noexcept {
+    return m_erased.empty() and m_inserted.empty() and m_changed.empty() and
+           m_slots.empty() and not m_header_changed;
+  }
+
+  // Returns false, with map partially updated but still consistent, if map
+  // is not in the state the delta was computed from. Inserted elements get
+  // exactly the keys they have in the new state.
+  bool apply(Map &map) const {
+    for (auto k : m_erased) {
+      if (not map.try_erase(k)) {
+        return false;
+      }
+    }
+    for (const auto &[k, value, active] : m_changed) {
+      auto *ptr = map.get(k);
+      if (not ptr) {
+        return false;
+      }
+      *ptr = value;
+      map.set_active(k, active);
+    }
+    // Check all inserts before touching any slot, so that a mismatch leaves
+    // the free list intact
+    if (m_num_slots < map.m_slots.size()) {
+      return false;
+    }
+    for (const auto &entry : m_inserted) {
+      auto [slot_index, version] = Map::key_parts(entry.key);
+      if (version < m_version_floor or slot_index >= m_num_slots) {
+        return false;
+      }
+      if (slot_index < map.m_slots.size() and
+          (map.is_live_slot(slot_index) or
+           version < map.m_slots[slot_index].version)) {
+        return false;
+      }
+    }
+    map.m_slots.resize(m_num_slots,
+                       {.index = Map::NULL_SLOT, .version = m_version_floor});
+    for (const auto &[k, value, active] : m_inserted) {
+      auto [slot_index, version] = Map::key_parts(k);
+      uint32_t index = map.m_keys.size();
+      map.m_values.push_back(value);
+      map.m_keys.push_back(Map::stored_key(k));
+      map.m_slots[slot_index] = {.index = index, .version = version};
+      if (active) {
+        map.activate_back();
+      }
+    }
+    for (auto [slot_index, next_free, version] : m_slots) {
+      map.m_slots[slot_index] = {.next_free = next_free, .version = version};
+    }
+    map.m_free_head = m_free_head;
+    map.m_lazy_free = m_lazy_free;
+    map.m_version_floor = m_version_floor;
+    map.m_max_version = m_max_version;
+    return true;
+  }
+};
+
+template <typename Map>
+SlotMapDelta<Map> diff(const Map &old_map, const Map &new_map) {
+  return SlotMapDelta<Map>::diff(old_map, new_map);
+}
+
+} // namespace Attractadore
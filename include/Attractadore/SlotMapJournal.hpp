@@ -0,0 +1,299 @@
+#pragma once
+#include "DenseSlotMap.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <span>
+
+namespace Attractadore {
+namespace detail {
+
+class JournalWriter {
+  std::vector<std::byte> &m_bytes;
+
+public:
+  explicit JournalWriter(std::vector<std::byte> &bytes) noexcept
+      : m_bytes{bytes} {}
+
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  void put(const T &value) {
+    auto offset = m_bytes.size();
+    m_bytes.resize(offset + sizeof(T));
+    std::memcpy(m_bytes.data() + offset, &value, sizeof(T));
+  }
+};
+
+class JournalReader {
+  std::span<const std::byte> m_bytes;
+
+public:
+  explicit JournalReader(std::span<const std::byte> bytes) noexcept
+      : m_bytes{bytes} {}
+
+  bool empty() const noexcept { return m_bytes.empty(); }
+
+  template <typename T>
+    requires std::is_trivially_copyable_v<T>
+  bool get(T &value) noexcept {
+    if (m_bytes.size() < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&value, m_bytes.data(), sizeof(T));
+    m_bytes = m_bytes.subspan(sizeof(T));
+    return true;
+  }
+};
+
+} // namespace detail
+
+// A sink appends bytes to the end of the log, reports the log size, and
+// drops the bytes before an offset. Bytes must be durable once append()
+// returns, since a checkpoint discards the records it replaces only after it
+// was appended itself.
+template <typename S>
+concept CJournalSink =
+    requires(S &sink, std::span<const std::byte> bytes, size_t offset) {
+      sink.append(bytes);
+      { sink.size() } -> std::convertible_to<size_t>;
+      sink.discard_before(offset);
+    };
+
+// Journal sink that keeps the log in memory
+struct MemoryJournalSink {
+  std::vector<std::byte> bytes;
+
+  void append(std::span<const std::byte> data) {
+    bytes.insert(bytes.end(), data.begin(), data.end());
+  }
+
+  size_t size() const noexcept { return bytes.size(); }
+
+  void discard_before(size_t offset) noexcept {
+    bytes.erase(bytes.begin(), bytes.begin() + offset);
+  }
+};
+
+// DenseSlotMap that appends a record for every mutation to a log. Records are
+// buffered and handed to the sink in groups by commit(). checkpoint() writes
+// the complete map state and then discards the log before it, and replay()
+// rebuilds the map, keys included, from a log.
+template <typename Map, typename Sink> class JournaledSlotMap {
+  static_assert(detail::IsDenseSlotMap<Map>);
+  static_assert(CJournalSink<Sink>);
+
+public:
+  using key_type = typename Map::key_type;
+  using value_type = typename Map::value_type;
+  using const_iterator = typename Map::const_iterator;
+  using size_type = typename Map::size_type;
+
+  static_assert(std::is_trivially_copyable_v<value_type>,
+                "Journaled values are stored as raw bytes");
+
+private:
+  enum class Op : uint8_t {
+    Emplace,
+    Assign,
+    Erase,
+    Clear,
+    Checkpoint,
+  };
+
+  Map m_map;
+  Sink m_sink;
+  std::vector<std::byte> m_buffer;
+  size_t m_group_size;
+
+public:
+  explicit JournaledSlotMap(Sink sink, size_t group_size = 64 * 1024)
+      : m_sink{std::move(sink)}, m_group_size{group_size} {}
+
+  // Commit pending records before destruction to not lose them. A sink that
+  // fails here loses them anyway, as the destructor cannot throw; call
+  // commit() first to handle the failure.
+  ~JournaledSlotMap() {
+    try {
+      commit();
+    } catch (...) {
+    }
+  }
+
+  JournaledSlotMap(const JournaledSlotMap &) = delete;
+  JournaledSlotMap &operator=(const JournaledSlotMap &) = delete;
+
+  const Map &map() const noexcept { return m_map; }
+
+  const Sink &sink() const noexcept { return m_sink; }
+
+  Sink &sink() noexcept { return m_sink; }
+
+  decltype(auto) keys() const noexcept { return m_map.keys(); }
+
+  const auto &values() const noexcept { return m_map.values(); }
+
+  const_iterator begin() const noexcept { return m_map.begin(); }
+
+  const_iterator end() const noexcept { return m_map.end(); }
+
+  bool empty() const noexcept { return m_map.empty(); }
+
+  size_type size() const noexcept { return m_map.size(); }
+
+  const_iterator find(key_type k) const noexcept { return m_map.find(k); }
+
+  const value_type *get(key_type k) const noexcept { return m_map.get(k); }
+
+  const value_type &operator[](key_type k) const noexcept { return m_map[k]; }
+
+  bool contains(key_type k) const noexcept { return m_map.contains(k); }
+
+  [[nodiscard]] key_type insert(const value_type &value) {
+    return emplace(value);
+  }
+
+  template <typename... Args>
+    requires std::constructible_from<value_type, Args &&...>
+  [[nodiscard]] key_type emplace(Args &&...args) {
+    auto [k, value] = *m_map.emplace(std::forward<Args>(args)...);
+    record(Op::Emplace, k, &value);
+    return k;
+  }
+
+  void assign(key_type k, const value_type &value) {
+    m_map[k] = value;
+    record(Op::Assign, k, &value);
+  }
+
+  void erase(key_type k) {
+    m_map.erase(k);
+    record(Op::Erase, k);
+  }
+
+  [[nodiscard]] bool try_erase(key_type k) {
+    if (m_map.contains(k)) {
+      erase(k);
+      return true;
+    }
+    return false;
+  }
+
+  [[nodiscard]] value_type pop(key_type k) {
+    auto value = m_map.pop(k);
+    record(Op::Erase, k);
+    return value;
+  }
+
+  [[nodiscard]] std::optional<value_type> try_pop(key_type k) {
+    if (m_map.contains(k)) {
+      return pop(k);
+    }
+    return std::nullopt;
+  }
+
+  void clear() {
+    m_map.clear();
+    detail::JournalWriter w(m_buffer);
+    w.put(Op::Clear);
+    maybe_commit();
+  }
+
+  // Hand all buffered records to the sink
+  void commit() {
+    if (not m_buffer.empty()) {
+      m_sink.append(m_buffer);
+      m_buffer.clear();
+    }
+  }
+
+  // Replace the log with a snapshot of the current state. Pending records
+  // are superseded by the snapshot. If the old log cannot be discarded, it
+  // still replays to the current state, since the snapshot follows it.
+  void checkpoint() {
+    m_buffer.clear();
+    size_t offset = m_sink.size();
+    detail::JournalWriter w(m_buffer);
+    w.put(Op::Checkpoint);
+    m_map.write_state(w);
+    commit();
+    m_sink.discard_before(offset);
+  }
+
+  // Rebuild a map from a log, or return nothing if the log is corrupt
+  static std::optional<Map> replay(std::span<const std::byte> log) {
+    Map map;
+    detail::JournalReader r(log);
+    while (not r.empty()) {
+      Op op;
+      if (not r.get(op)) {
+        return std::nullopt;
+      }
+      if (op == Op::Clear) {
+        map.clear();
+        continue;
+      }
+      if (op == Op::Checkpoint) {
+        if (not map.read_state(r)) {
+          return std::nullopt;
+        }
+        continue;
+      }
+      uint32_t slot_index, version;
+      if (not(r.get(slot_index) and r.get(version))) {
+        return std::nullopt;
+      }
+      value_type value;
+      switch (op) {
+      case Op::Emplace: {
+        if (not r.get(value)) {
+          return std::nullopt;
+        }
+        // Slot allocation is deterministic, so replaying the same operations
+        // reproduces the same keys
+        auto k = map.emplace(value)->first;
+        if (Map::key_parts(k) != std::pair(slot_index, version)) {
+          return std::nullopt;
+        }
+        break;
+      }
+      case Op::Assign: {
+        auto *ptr = map.get(Map::make_key(slot_index, version));
+        if (not ptr or not r.get(value)) {
+          return std::nullopt;
+        }
+        *ptr = value;
+        break;
+      }
+      case Op::Erase:
+        if (not map.try_erase(Map::make_key(slot_index, version))) {
+          return std::nullopt;
+        }
+        break;
+      default:
+        return std::nullopt;
+      }
+    }
+    return map;
+  }
+
+private:
+  void record(Op op, key_type k, const value_type *value = nullptr) {
+    auto [slot_index, version] = Map::key_parts(k);
+    detail::JournalWriter w(m_buffer);
+    w.put(op);
+    w.put(slot_index);
+    w.put(version);
+    if (value) {
+      w.put(*value);
+    }
+    maybe_commit();
+  }
+
+  void maybe_commit() {
+    if (m_buffer.size() >= m_group_size) {
+      commit();
+    }
+  }
+};
+
+} // namespace Attractadore
@@ -0,0 +1,301 @@
+#pragma once
+#include "DenseSlotMap.hpp"
+
+#include <bit>
+
+namespace Attractadore {
+namespace detail {
+
+// Hierarchical timer wheel. Level L has 64 buckets of 64^L ticks each, and a
+// timer is placed on the lowest level whose bucket period contains both the
+// current tick and the deadline. Timers are moved down one level when the
+// wheel reaches their bucket, so each timer is touched at most once per level.
+// Empty buckets are tracked in a bit mask per level, and the wheel jumps
+// straight to the next tick at which a bucket has to be processed.
+template <typename K> class TimerWheel {
+  static constexpr unsigned BITS = 6;
+  static constexpr unsigned NUM_BUCKETS = 1 << BITS;
+  static constexpr unsigned NUM_LEVELS = 4;
+  static constexpr uint64_t MASK = NUM_BUCKETS - 1;
+  static constexpr uint64_t NO_EVENT = std::numeric_limits<uint64_t>::max();
+
+public:
+  struct Timer {
+    K key;
+    uint64_t deadline;
+  };
+
+private:
+  using Bucket = std::vector<Timer>;
+
+  std::array<std::array<Bucket, NUM_BUCKETS>, NUM_LEVELS> m_levels;
+  // Bit b of m_occupied[L] is set if bucket b of level L is not empty
+  std::array<uint64_t, NUM_LEVELS> m_occupied = {};
+  Bucket m_overflow;
+  uint64_t m_now = 0;
+  size_t m_size = 0;
+
+public:
+  uint64_t now() const noexcept { return m_now; }
+
+  size_t size() const noexcept { return m_size; }
+
+  // Deadlines at or before now() are moved to the next tick. Returns the
+  // deadline the timer was scheduled for.
+  uint64_t schedule(K key, uint64_t deadline) {
+    deadline = std::max(deadline, m_now + 1);
+    place({key, deadline});
+    m_size++;
+    return deadline;
+  }
+
+  // Advance to tick now and call fire on every due timer for which live
+  // returns true. Timers for which live returns false are dropped when they
+  // are reached, whether they are due or only moved down a level. The cost is
+  // proportional to the number of timers processed, not to the ticks passed.
+  template <typename Live, typename Fire>
+  void advance(uint64_t now, Live &&live, Fire &&fire) {
+    while (m_now < now) {
+      auto next = next_event();
+      if (next > now) {
+        m_now = now;
+        return;
+      }
+      m_now = next;
+      process(live, fire);
+    }
+  }
+
+  void clear() noexcept {
+    for (auto &level : m_levels) {
+      for (auto &bucket : level) {
+        bucket.clear();
+      }
+    }
+    m_occupied = {};
+    m_overflow.clear();
+    m_size = 0;
+  }
+
+private:
+  void place(Timer timer) {
+    for (unsigned level = 0; level < NUM_LEVELS; level++) {
+      auto shift = BITS * (level + 1);
+      if ((timer.deadline >> shift) == (m_now >> shift)) {
+        auto bucket = (timer.deadline >> (BITS * level)) & MASK;
+        m_levels[level][bucket].push_back(timer);
+        m_occupied[level] |= uint64_t(1) << bucket;
+        return;
+      }
+    }
+    m_overflow.push_back(timer);
+  }
+
+  // First tick after now() at which a non-empty bucket is processed. On every
+  // level, buckets up to the current one have already been processed in the
+  // current period, and timers are only ever placed in later buckets.
+  uint64_t next_event() const noexcept {
+    auto next = NO_EVENT;
+    for (unsigned level = 0; level < NUM_LEVELS; level++) {
+      auto shift = BITS * level;
+      auto current = (m_now >> shift) & MASK;
+      if (current == MASK) {
+        continue;
+      }
+      auto pending = m_occupied[level] >> (current + 1) << (current + 1);
+      if (pending != 0) {
+        auto period = shift + BITS;
+        auto start = m_now >> period << period;
+        uint64_t bucket = std::countr_zero(pending);
+        next = std::min(next, start | bucket << shift);
+      }
+    }
+    constexpr auto top = BITS * NUM_LEVELS;
+    if (not m_overflow.empty() and (m_now >> top) != (NO_EVENT >> top)) {
+      next = std::min(next, ((m_now >> top) + 1) << top);
+    }
+    return next;
+  }
+
+  template <typename Live> void cascade(Bucket &bucket, Live &live) {
+    Bucket timers = std::move(bucket);
+    bucket.clear();
+    for (auto timer : timers) {
+      if (live(timer)) {
+        place(timer);
+      } else {
+        m_size--;
+      }
+    }
+  }
+
+  template <typename Live, typename Fire>
+  void process(Live &live, Fire &fire) {
+    constexpr auto top = BITS * NUM_LEVELS;
+    if ((m_now & ((uint64_t(1) << top) - 1)) == 0) {
+      cascade(m_overflow, live);
+    }
+    for (unsigned level = NUM_LEVELS - 1; level > 0; level--) {
+      auto shift = BITS * level;
+      if ((m_now & ((uint64_t(1) << shift) - 1)) == 0) {
+        auto bucket = (m_now >> shift) & MASK;
+        m_occupied[level] &= ~(uint64_t(1) << bucket);
+        cascade(m_levels[level][bucket], live);
+      }
+    }
+    auto bucket = m_now & MASK;
+    m_occupied[0] &= ~(uint64_t(1) << bucket);
+    Bucket timers = std::move(m_levels[0][bucket]);
+    m_levels[0][bucket].clear();
+    m_size -= timers.size();
+    for (auto timer : timers) {
+      assert(timer.deadline == m_now);
+      if (live(timer)) {
+        fire(timer);
+      }
+    }
+  }
+};
+
+} // namespace detail
+
+// DenseSlotMap whose elements can expire. Deadlines are given in
+// caller-defined ticks and tracked by a timer wheel, so expire() only
+// touches timers that are due. Erased elements and refreshed deadlines leave
+// stale timers behind, which are recognized by the key version and the
+// current deadline and dropped when the wheel reaches them. Deadlines at or
+// before now() are moved to now() + 1.
+template <typename T, CSlotMapKey K = SlotMapKey,
+          template <typename> typename C = detail::StdVector>
+class TtlSlotMap {
+  using Map = DenseSlotMap<T, K, C>;
+
+  Map m_map;
+  // Deadline of the element in each slot
+  C<uint64_t> m_deadlines;
+  detail::TimerWheel<K> m_wheel;
+
+public:
+  using key_type = typename Map::key_type;
+  using value_type = typename Map::value_type;
+  using iterator = typename Map::iterator;
+  using const_iterator = typename Map::const_iterator;
+  using size_type = typename Map::size_type;
+
+  static constexpr uint64_t NEVER = std::numeric_limits<uint64_t>::max();
+
+  const Map &map() const noexcept { return m_map; }
+
+  decltype(auto) keys() const noexcept { return m_map.keys(); }
+
+  const auto &values() const noexcept { return m_map.values(); }
+
+  auto &values() noexcept { return m_map.values(); }
+
+  const_iterator begin() const noexcept { return m_map.begin(); }
+
+  const_iterator end() const noexcept { return m_map.end(); }
+
+  iterator begin() noexcept { return m_map.begin(); }
+
+  iterator end() noexcept { return m_map.end(); }
+
+  bool empty() const noexcept { return m_map.empty(); }
+
+  size_type size() const noexcept { return m_map.size(); }
+
+  // Last tick passed to expire()
+  uint64_t now() const noexcept { return m_wheel.now(); }
+
+  template <typename... Args>
+    requires std::constructible_from<value_type, Args &&...>
+  [[nodiscard]] key_type emplace(Args &&...args) {
+    return emplace_with_ttl(NEVER, std::forward<Args>(args)...);
+  }
+
+  template <typename... Args>
+    requires std::constructible_from<value_type, Args &&...>
+  [[nodiscard]] key_type emplace_with_ttl(uint64_t deadline, Args &&...args) {
+    auto k = m_map.emplace(std::forward<Args>(args)...)->first;
+    auto slot_index = Map::key_parts(k).first;
+    if (slot_index >= m_deadlines.size()) {
+      m_deadlines.resize(slot_index + 1, NEVER);
+    }
+    set_deadline(k, deadline);
+    return k;
+  }
+
+  // Replace the deadline of an element; the old timer is dropped lazily
+  void refresh(key_type k, uint64_t deadline) {
+    assert(contains(k));
+    set_deadline(k, deadline);
+  }
+
+  uint64_t deadline(key_type k) const noexcept {
+    assert(contains(k));
+    return m_deadlines[Map::key_parts(k).first];
+  }
+
+  // Erase all elements whose deadline is at or before now, calling
+  // on_expire(key, value) for each one first
+  template <typename F>
+    requires std::invocable<F &, key_type, value_type &>
+  size_type expire(uint64_t now, F &&on_expire) {
+    size_type count = 0;
+    auto live = [&](const auto &timer) {
+      return m_map.contains(timer.key) and
+             m_deadlines[Map::key_parts(timer.key).first] == timer.deadline;
+    };
+    m_wheel.advance(now, live, [&](const auto &timer) {
+      std::invoke(on_expire, timer.key, m_map[timer.key]);
+      m_map.erase(timer.key);
+      count++;
+    });
+    return count;
+  }
+
+  size_type expire(uint64_t now) {
+    return expire(now, [](key_type, value_type &) {});
+  }
+
+  void erase(key_type k) noexcept { m_map.erase(k); }
+
+  [[nodiscard]] bool try_erase(key_type k) noexcept {
+    return m_map.try_erase(k);
+  }
+
+  [[nodiscard]] value_type pop(key_type k) noexcept { return m_map.pop(k); }
+
+  [[nodiscard]] std::optional<value_type> try_pop(key_type k) noexcept {
+    return m_map.try_pop(k);
+  }
+
+  void clear() noexcept {
+    m_map.clear();
+    m_wheel.clear();
+  }
+
+  const_iterator find(key_type k) const noexcept { return m_map.find(k); }
+
+  iterator find(key_type k) noexcept { return m_map.find(k); }
+
+  const value_type *get(key_type k) const noexcept { return m_map.get(k); }
+
+  value_type *get(key_type k) noexcept { return m_map.get(k); }
+
+  const value_type &operator[](key_type k) const noexcept { return m_map[k]; }
+
+  value_type &operator[](key_type k) noexcept { return m_map[k]; }
+
+  bool contains(key_type k) const noexcept { return m_map.contains(k); }
+
+private:
+  void set_deadline(key_type k, uint64_t deadline) {
+    if (deadline != NEVER) {
+      deadline = m_wheel.schedule(k, deadline);
+    }
+    m_deadlines[Map::key_parts(k).first] = deadline;
+  }
+};
+
+} // namespace Attractadore
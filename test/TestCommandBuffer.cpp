@@ -0,0 +1,127 @@
+#include "Attractadore/CommandBuffer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using Attractadore::CommandBuffer;
+using Attractadore::DenseSlotMap;
+using Attractadore::KeyPool;
+
+using Map = DenseSlotMap<int>;
+
+TEST(TestCommandBuffer, ReservedKeys) {
+  Map s;
+  KeyPool<Map> pool;
+  pool.refill(s, 4);
+  EXPECT_EQ(pool.available(), 4);
+  CommandBuffer<Map> buffer(pool);
+  auto k = buffer.emplace(1);
+  EXPECT_FALSE(k.is_null());
+  EXPECT_FALSE(s.contains(k));
+  EXPECT_TRUE(s.empty());
+  apply(s, buffer);
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_TRUE(s.contains(k));
+  EXPECT_EQ(s[k], 1);
+}
+
+TEST(TestCommandBuffer, Exhausted) {
+  Map s;
+  KeyPool<Map> pool;
+  pool.refill(s, 1);
+  CommandBuffer<Map> buffer(pool);
+  EXPECT_FALSE(buffer.emplace(1).is_null());
+  EXPECT_TRUE(buffer.emplace(2).is_null());
+  EXPECT_EQ(buffer.size(), 1);
+}
+
+TEST(TestCommandBuffer, Erase) {
+  Map s;
+  auto k1 = s.insert(1);
+  KeyPool<Map> pool;
+  pool.refill(s, 4);
+  CommandBuffer<Map> buffer(pool);
+  auto k2 = buffer.emplace(2);
+  auto k3 = buffer.emplace(3);
+  buffer.erase(k1);
+  buffer.erase(k2);
+  // Reserved but never emplaced
+  auto k4 = buffer.reserve_key();
+  buffer.erase(k4);
+  apply(s, buffer);
+  EXPECT_EQ(s.size(), 1);
+  EXPECT_FALSE(s.contains(k1));
+  EXPECT_FALSE(s.contains(k2));
+  EXPECT_TRUE(s.contains(k3));
+  EXPECT_FALSE(s.contains(k4));
+}
+
+TEST(TestCommandBuffer, EraseFromOtherBuffer) {
+  Map s;
+  KeyPool<Map> pool;
+  pool.refill(s, 4);
+  CommandBuffer<Map> a(pool);
+  CommandBuffer<Map> b(pool);
+  auto k1 = a.emplace(1);
+  auto k2 = a.emplace(2);
+  b.erase(k1);
+  // b is applied first, so k1 is gone before a emplaces at it
+  apply(s, b, a);
+  EXPECT_EQ(s.size(), 1);
+  EXPECT_FALSE(s.contains(k1));
+  EXPECT_TRUE(s.contains(k2));
+  auto k3 = s.insert(3);
+  EXPECT_EQ(s.size(), 2);
+  EXPECT_EQ(s[k3], 3);
+}
+
+TEST(TestCommandBuffer, RefillReleasesUnused) {
+  Map s;
+  KeyPool<Map> pool;
+  pool.refill(s, 8);
+  auto unused = pool.reserve_key();
+  pool.refill(s, 0);
+  EXPECT_EQ(pool.available(), 0);
+  std::vector<Map::key_type> keys;
+  for (int i = 0; i < 8; i++) {
+    keys.push_back(s.insert(i));
+  }
+  // The released slots are reused without bringing back the reserved key
+  EXPECT_FALSE(s.contains(unused));
+  EXPECT_EQ(s.size(), 8);
+  for (int i = 0; i < 8; i++) {
+    EXPECT_EQ(s[keys[i]], i);
+  }
+}
+
+TEST(TestCommandBuffer, Threads) {
+  Map s;
+  KeyPool<Map> pool;
+  constexpr int num_threads = 4;
+  constexpr int per_thread = 1000;
+  pool.refill(s, num_threads * per_thread);
+  std::vector<CommandBuffer<Map>> buffers(num_threads,
+                                          CommandBuffer<Map>(pool));
+  std::vector<std::vector<Map::key_type>> keys(num_threads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < per_thread; i++) {
+        keys[t].push_back(buffers[t].emplace(t * per_thread + i));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto &buffer : buffers) {
+    buffer.apply(s);
+  }
+  EXPECT_EQ(s.size(), num_threads * per_thread);
+  for (int t = 0; t < num_threads; t++) {
+    for (int i = 0; i < per_thread; i++) {
+      EXPECT_EQ(s[keys[t][i]], t * per_thread + i);
+    }
+  }
+}
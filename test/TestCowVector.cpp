@@ -0,0 +1,105 @@
+#include "Attractadore/CowVector.hpp"
+#include "Attractadore/DenseSlotMap.hpp"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <ranges>
+#include <string>
+#include <utility>
+
+using Attractadore::CowChunkedVector;
+using Attractadore::DenseSlotMap;
+using Attractadore::detail::CowVector;
+
+static_assert(std::ranges::random_access_range<CowVector<int>>);
+static_assert(std::ranges::random_access_range<const CowVector<int>>);
+
+template class Attractadore::DenseSlotMap<int, Attractadore::SlotMapKey,
+                                          CowChunkedVector>;
+
+TEST(TestCowVector, PushPop) {
+  CowVector<std::string, 4> v;
+  for (int i = 0; i < 10; i++) {
+    v.push_back(std::to_string(i));
+  }
+  EXPECT_EQ(v.size(), 10);
+  EXPECT_EQ(v.back(), "9");
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(v[i], std::to_string(i));
+  }
+  v.pop_back();
+  v.pop_back();
+  EXPECT_EQ(v.size(), 8);
+  EXPECT_EQ(v.back(), "7");
+  EXPECT_TRUE(std::ranges::equal(v | std::views::take(2),
+                                 std::array{"0", "1"}));
+}
+
+TEST(TestCowVector, CopyOnWrite) {
+  CowVector<int, 4> v;
+  for (int i = 0; i < 16; i++) {
+    v.push_back(i);
+  }
+  auto copy = v;
+  EXPECT_EQ(v.unshared_chunks(), 0);
+  v[5] = -5;
+  EXPECT_EQ(v.unshared_chunks(), 1);
+  EXPECT_EQ(copy[5], 5);
+  EXPECT_EQ(v[5], -5);
+  v.push_back(16);
+  EXPECT_EQ(copy.size(), 16);
+  EXPECT_NE(v, copy);
+  v.pop_back();
+  v[5] = 5;
+  EXPECT_EQ(v, copy);
+}
+
+TEST(TestCowVector, AssignSharesChunks) {
+  CowVector<int, 4> v;
+  for (int i = 0; i < 16; i++) {
+    v.push_back(i);
+  }
+  auto snapshot = v;
+  v[5] = -5;
+  v.push_back(16);
+  v = snapshot;
+  EXPECT_EQ(v, snapshot);
+  EXPECT_EQ(v.unshared_chunks(), 0);
+  EXPECT_EQ(std::as_const(v)[5], 5);
+  v.pop_back();
+  v.pop_back();
+  v.pop_back();
+  v.pop_back();
+  v.pop_back();
+  v = snapshot;
+  EXPECT_EQ(v, snapshot);
+  EXPECT_EQ(v.unshared_chunks(), 0);
+}
+
+TEST(TestCowVector, SlotMapFork) {
+  DenseSlotMap<int, Attractadore::SlotMapKey, CowChunkedVector> s;
+  using Key = decltype(s)::key_type;
+  std::vector<Key> keys;
+  for (int i = 0; i < 10000; i++) {
+    keys.push_back(s.insert(i));
+  }
+  auto snapshot = s.fork();
+  EXPECT_EQ(std::as_const(s).unshared_chunks(), (std::array<size_t, 3>{}));
+  s[keys[10]] = -1;
+  s.erase(keys[20]);
+  auto k = s.insert(20000);
+  // Only the chunks holding the first elements and the back ones were copied
+  EXPECT_EQ(std::as_const(s).unshared_chunks(),
+            (std::array<size_t, 3>{2, 2, 2}));
+  EXPECT_EQ(snapshot[keys[10]], 10);
+  EXPECT_TRUE(snapshot.contains(keys[20]));
+  EXPECT_FALSE(snapshot.contains(k));
+
+  s.restore(snapshot);
+  EXPECT_EQ(std::as_const(s).unshared_chunks(), (std::array<size_t, 3>{}));
+  EXPECT_EQ(s, snapshot);
+  EXPECT_EQ(s[keys[10]], 10);
+  EXPECT_EQ(s[keys[20]], 20);
+  EXPECT_FALSE(s.contains(k));
+}
@@ -4,6 +4,8 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <ranges>
 
 namespace Attractadore {
 std::ostream &operator<<(std::ostream &os, SlotMapKey key) {
@@ -26,6 +28,20 @@ static_assert(std::forward_iterator<TestIterator>);
 static_assert(std::bidirectional_iterator<TestIterator>);
 static_assert(std::random_access_iterator<TestIterator>);
 
+using Attractadore::KeyStorage;
+template <typename T>
+using IndexOnlySlotMap =
+    DenseSlotMap<T, Attractadore::SlotMapKey, Attractadore::detail::StdVector,
+                 KeyStorage::SlotIndex>;
+template class Attractadore::DenseSlotMap<int, Attractadore::SlotMapKey,
+                                          Attractadore::detail::StdVector,
+                                          KeyStorage::SlotIndex>;
+
+using IndexOnlyIterator = IndexOnlySlotMap<int>::iterator;
+static_assert(std::random_access_iterator<IndexOnlyIterator>);
+static_assert(
+    std::random_access_iterator<IndexOnlySlotMap<int>::const_iterator>);
+
 TEST(TestIsEmpty, Empty) {
   DenseSlotMap<int> s;
   EXPECT_TRUE(s.empty());
@@ -431,3 +447,462 @@ TEST(TestKeysValues, KeysValues) {
   EXPECT_TRUE(std::ranges::is_permutation(s.keys(), keys));
   EXPECT_TRUE(std::ranges::is_permutation(s.values(), values));
 }
+
+static_assert(std::ranges::input_range<
+              Attractadore::JoinView<DenseSlotMap<int>, DenseSlotMap<int>>>);
+
+TEST(TestJoin, Intersection) {
+  DenseSlotMap<int> s1;
+  DenseSlotMap<float> s2;
+  using Key = decltype(s1)::key_type;
+  std::vector<Key> keys;
+  for (int i = 0; i < 32; i++) {
+    keys.push_back(s1.insert(i));
+    auto k = s2.insert(i * 0.5f);
+    EXPECT_EQ(keys.back(), k);
+  }
+  for (int i = 0; i < 32; i += 3) {
+    s2.erase(keys[i]);
+  }
+  size_t count = 0;
+  for (auto [k, i, f] : Attractadore::join(s1, s2)) {
+    EXPECT_EQ(s1[k], i);
+    EXPECT_NE(i % 3, 0);
+    EXPECT_EQ(f, i * 0.5f);
+    f = -1.0f;
+    count++;
+  }
+  EXPECT_EQ(count, s2.size());
+  EXPECT_TRUE(std::ranges::all_of(s2.values(), [](float f) { return f < 0; }));
+}
+
+TEST(TestJoin, ForeignKeys) {
+  DenseSlotMap<int> s1;
+  DenseSlotMap<int> s2;
+  for (int i = 0; i < 16; i++) {
+    std::ignore = s1.insert(i);
+  }
+  auto k = s2.insert(0);
+  const auto &cs1 = s1;
+  size_t count = 0;
+  for (auto [key, v2, v1] : Attractadore::join(s2, cs1)) {
+    EXPECT_EQ(key, k);
+    EXPECT_EQ(v1, v2);
+    count++;
+  }
+  EXPECT_EQ(count, 1);
+  s2.clear();
+  EXPECT_EQ(std::ranges::distance(Attractadore::join(cs1, s2)), 0);
+}
+
+TEST(TestJoin, FreeSlotVersion) {
+  DenseSlotMap<int> s1;
+  DenseSlotMap<int> s2;
+  using Key = decltype(s1)::key_type;
+  std::vector<Key> keys;
+  for (int i = 0; i < 4; i++) {
+    keys.push_back(s1.insert(i));
+    std::ignore = s2.insert(i);
+  }
+  s1.erase(keys[0]);
+  s1.erase(keys[3]);
+  s1.erase(keys[1]);
+  auto k = s1.insert(1);
+  // The free slot of s2 has the version of k and links to a valid index
+  s2.erase(keys[0]);
+  s2.erase(keys[1]);
+  EXPECT_FALSE(s2.contains(k));
+  size_t count = 0;
+  for (auto [key, v1, v2] : Attractadore::join(s1, s2)) {
+    EXPECT_EQ(key, keys[2]);
+    count++;
+  }
+  EXPECT_EQ(count, 1);
+}
+
+TEST(TestMerge, Remap) {
+  DenseSlotMap<int> s1, s2;
+  using Key = decltype(s1)::key_type;
+  std::vector<Key> keys1, keys2;
+  for (int i = 0; i < 8; i++) {
+    keys1.push_back(s1.insert(i));
+    keys2.push_back(s2.insert(100 + i));
+  }
+  s1.erase(keys1[2]);
+  auto stale = keys2[5];
+  s2.erase(stale);
+  keys2.erase(keys2.begin() + 5);
+
+  auto remap = s1.merge(std::move(s2));
+  EXPECT_TRUE(s2.empty());
+  EXPECT_EQ(s1.size(), 7 + 7);
+  EXPECT_TRUE(remap(stale).is_null());
+  for (size_t i = 0; i < keys2.size(); i++) {
+    auto k = remap(keys2[i]);
+    ASSERT_FALSE(k.is_null());
+    EXPECT_EQ(s1[k], 100 + i + (i >= 5));
+  }
+  for (size_t i = 0; i < keys1.size(); i++) {
+    if (i != 2) {
+      EXPECT_EQ(s1[keys1[i]], i);
+    }
+  }
+
+  auto refs = keys2;
+  remap.apply(refs);
+  for (auto k : refs) {
+    EXPECT_TRUE(s1.contains(k));
+  }
+}
+
+TEST(TestMerge, Preserve) {
+  DenseSlotMap<int> s1, s2;
+  using Key = decltype(s1)::key_type;
+  std::vector<Key> keys2;
+  for (int i = 0; i < 8; i++) {
+    std::ignore = s1.insert(i);
+    keys2.push_back(s2.insert(100 + i));
+  }
+  // Slots overlap, keys can not be preserved
+  auto remap = s1.merge(std::move(s2), Attractadore::MergeKeys::Preserve);
+  EXPECT_NE(remap(keys2[0]), keys2[0]);
+
+  DenseSlotMap<int> s3;
+  std::vector<Key> keys3;
+  for (int i = 0; i < 20; i++) {
+    keys3.push_back(s3.insert(i));
+  }
+  for (int i = 0; i < 16; i++) {
+    s3.erase(keys3[i]);
+  }
+  keys3.erase(keys3.begin(), keys3.begin() + 16);
+  auto size = s1.size();
+  remap = s1.merge(std::move(s3), Attractadore::MergeKeys::Preserve);
+  EXPECT_EQ(s1.size(), size + 4);
+  for (size_t i = 0; i < keys3.size(); i++) {
+    EXPECT_EQ(remap(keys3[i]), keys3[i]);
+    EXPECT_EQ(s1[keys3[i]], 16 + i);
+  }
+  // Gap slots are reusable
+  for (int i = 0; i < 8; i++) {
+    auto k = s1.insert(-1);
+    EXPECT_EQ(s1[k], -1);
+  }
+  for (size_t i = 0; i < keys3.size(); i++) {
+    EXPECT_EQ(s1[keys3[i]], 16 + i);
+  }
+}
+
+TEST(TestTouch, Touch) {
+  DenseSlotMap<int> s;
+  using Key = decltype(s)::key_type;
+  std::vector<Key> keys;
+  for (int i = 0; i < 16; i++) {
+    keys.push_back(s.insert(i));
+  }
+  auto k = keys.back();
+  for (int i = 0; i < 5; i++) {
+    s.touch(k);
+  }
+  EXPECT_EQ(s.front().first, k);
+  EXPECT_EQ(s.front().second, 15);
+  for (int i = 0; i < 16; i++) {
+    EXPECT_EQ(s[keys[i]], i);
+  }
+}
+
+TEST(TestEvictBack, EvictBack) {
+  DenseSlotMap<int> s;
+  using Key = decltype(s)::key_type;
+  std::vector<Key> keys;
+  for (int i = 0; i < 8; i++) {
+    keys.push_back(s.insert(i));
+  }
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 3; j++) {
+      s.touch(keys[i]);
+    }
+  }
+  s.evict_back(4);
+  EXPECT_EQ(s.size(), 4);
+  for (int i = 0; i < 4; i++) {
+    EXPECT_TRUE(s.contains(keys[i]));
+  }
+  for (int i = 4; i < 8; i++) {
+    EXPECT_FALSE(s.contains(keys[i]));
+  }
+  s.evict_back(4);
+  EXPECT_TRUE(s.empty());
+}
+
+TEST(TestEvictBack, InsertionOrder) {
+  DenseSlotMap<int> s;
+  for (int i = 0; i < 8; i++) {
+    std::ignore = s.insert(i);
+  }
+  EXPECT_TRUE(std::ranges::equal(s.values(), std::views::iota(0, 8)));
+}
+
+TEST(TestEvictBack, InsertThenEvict) {
+  DenseSlotMap<int> s;
+  for (int i = 0; i < 8; i++) {
+    std::ignore = s.insert(i);
+  }
+  for (int i = 0; i < 8; i++) {
+    auto k = s.emplace_touched(100 + i)->first;
+    s.evict_back();
+    EXPECT_TRUE(s.contains(k));
+    EXPECT_EQ(s.size(), 8);
+  }
+}
+
+TEST(TestClear, StaleKeysAfterClear) {
+  DenseSlotMap<int> s;
+  using Key = decltype(s)::key_type;
+  std::vector<Key> old_keys;
+  for (int i = 0; i < 8; i++) {
+    old_keys.push_back(s.insert(i));
+  }
+  s.erase(old_keys[3]);
+  s.clear();
+  std::vector<Key> keys;
+  for (int i = 0; i < 12; i++) {
+    keys.push_back(s.insert(i));
+  }
+  for (auto k : old_keys) {
+    EXPECT_FALSE(s.contains(k));
+  }
+  for (int i = 0; i < 12; i++) {
+    EXPECT_EQ(s[keys[i]], i);
+  }
+  s.erase(keys[0]);
+  s.clear();
+  s.clear();
+  for (int i = 0; i < 4; i++) {
+    auto k = s.insert(i);
+    EXPECT_EQ(s[k], i);
+  }
+  for (auto k : keys) {
+    EXPECT_FALSE(s.contains(k));
+  }
+  for (auto k : old_keys) {
+    EXPECT_FALSE(s.contains(k));
+  }
+}
+
+TEST(TestClear, MovedFrom) {
+  DenseSlotMap<int> s;
+  for (int i = 0; i < 8; i++) {
+    std::ignore = s.insert(i);
+  }
+  s.clear();
+  auto s2 = std::move(s);
+  auto k = s.insert(0);
+  EXPECT_EQ(s[k], 0);
+  auto k2 = s2.insert(1);
+  EXPECT_EQ(s2[k2], 1);
+}
+
+TEST(TestRecycle, EmplaceRecycled) {
+  DenseSlotMap<std::vector<int>> s;
+  s.reserve_recycled(4);
+  auto k = s.emplace_recycled([](auto &v) { v.assign(100, 1); })->first;
+  auto *data = s[k].data();
+  s.erase(k);
+  EXPECT_EQ(s.recycled(), 1);
+  auto k2 = s.emplace_recycled([](auto &v) {
+    EXPECT_GE(v.capacity(), 100);
+    v.clear();
+    v.push_back(2);
+  })->first;
+  EXPECT_EQ(s.recycled(), 0);
+  EXPECT_EQ(s[k2].data(), data);
+  EXPECT_EQ(s[k2], std::vector{2});
+  EXPECT_FALSE(s.contains(k));
+}
+
+TEST(TestRecycle, Capacity) {
+  DenseSlotMap<std::vector<int>> s;
+  for (int i = 0; i < 8; i++) {
+    std::ignore = s.insert(std::vector<int>(10, i));
+  }
+  s.erase(s.begin());
+  EXPECT_EQ(s.recycled(), 0);
+  s.reserve_recycled(4);
+  s.clear();
+  EXPECT_EQ(s.recycled(), 4);
+  s.release_recycled();
+  EXPECT_EQ(s.recycled(), 0);
+  auto k = s.emplace_recycled([](auto &v) { v.push_back(1); })->first;
+  EXPECT_EQ(s[k], std::vector{1});
+}
+
+static_assert(std::contiguous_iterator<std::ranges::iterator_t<
+                  decltype(std::declval<DenseSlotMap<int> &>().values())>>);
+static_assert(std::contiguous_iterator<std::ranges::iterator_t<
+                  decltype(std::declval<DenseSlotMap<int> &>().keys())>>);
+
+TEST(TestForEachSpan, ForEachSpan) {
+  DenseSlotMap<int> s;
+  for (int i = 0; i < 100; i++) {
+    std::ignore = s.insert(i);
+  }
+  size_t blocks = 0;
+  s.for_each_span(
+      [&](std::span<const DenseSlotMap<int>::key_type> keys,
+          std::span<int> values) {
+        EXPECT_EQ(keys.size(), values.size());
+        EXPECT_LE(values.size(), 32);
+        for (auto &v : values) {
+          v *= 2;
+        }
+        blocks++;
+      },
+      32);
+  EXPECT_EQ(blocks, 4);
+  int sum = 0;
+  std::as_const(s).for_each_span(
+      [&](auto keys, std::span<const int> values) {
+        for (size_t i = 0; i < keys.size(); i++) {
+          EXPECT_EQ(s[keys[i]], values[i]);
+          sum += values[i];
+        }
+      });
+  EXPECT_EQ(sum, 99 * 100);
+}
+
+TEST(TestForEachSpan, Aligned) {
+  DenseSlotMap<int> s;
+  for (int i = 0; i < 1000; i++) {
+    std::ignore = s.insert(i);
+  }
+  size_t blocks = 0;
+  int next = 0;
+  s.for_each_span(
+      [&](auto, std::span<int> values) {
+        if (blocks++ > 0) {
+          EXPECT_EQ(reinterpret_cast<std::uintptr_t>(values.data()) % 64, 0);
+        }
+        EXPECT_EQ(values.front(), next);
+        next += static_cast<int>(values.size());
+      },
+      64);
+  EXPECT_EQ(next, 1000);
+}
+
+TEST(TestForEachSpan, SlotIndex) {
+  IndexOnlySlotMap<int> s;
+  for (int i = 0; i < 100; i++) {
+    std::ignore = s.insert(i);
+  }
+  size_t count = 0;
+  s.for_each_span(
+      [&](std::span<const uint32_t> slots, std::span<int> values) {
+        ASSERT_EQ(slots.size(), values.size());
+        for (size_t i = 0; i < slots.size(); i++) {
+          EXPECT_EQ(slots[i], values[i]);
+        }
+        count += values.size();
+      },
+      32);
+  EXPECT_EQ(count, 100);
+}
+
+TEST(TestKeyStorage, SlotIndex) {
+  IndexOnlySlotMap<int> s;
+  std::vector<decltype(s)::key_type> keys;
+  for (int i = 0; i < 16; i++) {
+    keys.push_back(s.insert(i));
+  }
+  for (int i = 0; i < 16; i += 2) {
+    s.erase(keys[i]);
+  }
+  auto k = s.insert(100);
+  EXPECT_FALSE(s.contains(keys[14]));
+  EXPECT_EQ(s[k], 100);
+  for (int i = 1; i < 16; i += 2) {
+    EXPECT_EQ(s[keys[i]], i);
+  }
+  for (auto [key, value] : s) {
+    EXPECT_EQ(s[key], value);
+  }
+  EXPECT_EQ(s.keys().size(), s.size());
+  EXPECT_EQ(s.keys()[0], s.begin()->first);
+}
+
+TEST(TestKeyStorage, Merge) {
+  IndexOnlySlotMap<int> s1;
+  IndexOnlySlotMap<int> s2;
+  auto k1 = s1.insert(1);
+  auto k2 = s2.insert(2);
+  auto remap = s1.merge(std::move(s2));
+  EXPECT_EQ(s1.size(), 2);
+  EXPECT_EQ(s1[k1], 1);
+  EXPECT_EQ(s1[remap(k2)], 2);
+}
+
+TEST(TestActive, SetActive) {
+  DenseSlotMap<int> s;
+  std::vector<decltype(s)::key_type> keys;
+  for (int i = 0; i < 8; i++) {
+    keys.push_back(s.insert(i));
+  }
+  EXPECT_EQ(s.active_size(), 8);
+  for (int i = 0; i < 8; i += 2) {
+    s.set_active(keys[i], false);
+  }
+  EXPECT_EQ(s.active_size(), 4);
+  EXPECT_FALSE(s.is_active(keys[0]));
+  EXPECT_TRUE(s.is_active(keys[1]));
+  EXPECT_TRUE(std::ranges::all_of(s.active_values(),
+                                  [](int v) { return v % 2 == 1; }));
+  EXPECT_TRUE(std::ranges::all_of(s.inactive_values(),
+                                  [](int v) { return v % 2 == 0; }));
+  s.set_active(keys[0], true);
+  EXPECT_EQ(s.active_size(), 5);
+  EXPECT_EQ(std::ranges::count(s.active_values(), 0), 1);
+  for (int i = 0; i < 8; i++) {
+    EXPECT_EQ(s[keys[i]], i);
+  }
+}
+
+TEST(TestActive, InsertAndErase) {
+  DenseSlotMap<int> s;
+  auto k1 = s.insert(1);
+  auto k2 = s.insert(2);
+  s.set_active(k1, false);
+  // New elements are active and go before inactive ones
+  auto k3 = s.insert(3);
+  EXPECT_TRUE(s.is_active(k3));
+  EXPECT_EQ(s.values().back(), 1);
+  s.erase(k2);
+  EXPECT_EQ(s.active_size(), 1);
+  EXPECT_EQ(s.active_values().front(), 3);
+  EXPECT_EQ(s.pop(k3), 3);
+  EXPECT_EQ(s.active_size(), 0);
+  EXPECT_EQ(s[k1], 1);
+  s.clear();
+  EXPECT_EQ(s.active_size(), 0);
+}
+
+TEST(TestActive, TouchAndMerge) {
+  DenseSlotMap<int> s1;
+  DenseSlotMap<int> s2;
+  std::vector<decltype(s1)::key_type> keys;
+  for (int i = 0; i < 4; i++) {
+    keys.push_back(s1.insert(i));
+  }
+  s1.set_active(keys[0], false);
+  s1.set_active(keys[1], false);
+  s1.touch(keys[0]);
+  s1.touch(keys[1]);
+  EXPECT_FALSE(s1.is_active(keys[0]));
+  EXPECT_FALSE(s1.is_active(keys[1]));
+  auto k = s2.insert(10);
+  auto inactive = s2.insert(11);
+  s2.set_active(inactive, false);
+  auto remap = s1.merge(std::move(s2));
+  EXPECT_EQ(s1.active_size(), 3);
+  EXPECT_TRUE(s1.is_active(remap(k)));
+  EXPECT_FALSE(s1.is_active(remap(inactive)));
+}
@@ -0,0 +1,116 @@
+#include "Attractadore/IndexedSlotMap.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+struct Person {
+  std::string name;
+  int age = 0;
+};
+} // namespace
+
+using PersonMap = Attractadore::IndexedSlotMap<
+    Attractadore::DenseSlotMap<Person>, Attractadore::HashIndex<&Person::name>,
+    Attractadore::SortedIndex<&Person::age>>;
+
+TEST(TestIndexedSlotMap, Find) {
+  PersonMap s;
+  auto alice = s.insert({"alice", 30});
+  auto bob = s.insert({"bob", 25});
+  auto carol = s.insert({"carol", 30});
+  EXPECT_EQ(s.index<0>().find("alice"), alice);
+  EXPECT_EQ(s.index<0>().find("bob"), bob);
+  EXPECT_TRUE(s.index<0>().find("dave").is_null());
+  EXPECT_EQ(s.index<1>().count(30), 2);
+  EXPECT_TRUE(std::ranges::is_permutation(s.index<1>().equal_range(30),
+                                          std::array{alice, carol}));
+  auto young = s.index<1>().range(0, 30);
+  EXPECT_EQ(std::ranges::distance(young), 1);
+  EXPECT_EQ(*young.begin(), bob);
+}
+
+TEST(TestIndexedSlotMap, Erase) {
+  PersonMap s;
+  auto alice = s.insert({"alice", 30});
+  auto bob = s.insert({"bob", 25});
+  s.erase(alice);
+  EXPECT_FALSE(s.index<0>().contains("alice"));
+  EXPECT_FALSE(s.index<1>().contains(30));
+  // Swap and pop moved bob, index still refers to the right element
+  EXPECT_EQ(s[s.index<0>().find("bob")].age, 25);
+  auto p = s.pop(bob);
+  EXPECT_EQ(p.name, "bob");
+  EXPECT_FALSE(s.index<0>().contains("bob"));
+  EXPECT_FALSE(s.try_erase(bob));
+  EXPECT_EQ(s.try_pop(bob), std::nullopt);
+}
+
+TEST(TestIndexedSlotMap, Modify) {
+  PersonMap s;
+  auto alice = s.insert({"alice", 30});
+  s.modify(alice, [](Person &p) {
+    p.name = "alicia";
+    p.age++;
+  });
+  EXPECT_FALSE(s.index<0>().contains("alice"));
+  EXPECT_EQ(s.index<0>().find("alicia"), alice);
+  EXPECT_EQ(s.index<1>().find(31), alice);
+  EXPECT_FALSE(s.index<1>().contains(30));
+}
+
+TEST(TestIndexedSlotMap, Clear) {
+  PersonMap s;
+  auto alice = s.insert({"alice", 30});
+  s.clear();
+  EXPECT_TRUE(s.empty());
+  EXPECT_FALSE(s.contains(alice));
+  EXPECT_FALSE(s.index<0>().contains("alice"));
+  EXPECT_FALSE(s.index<1>().contains(30));
+}
+
+namespace {
+int checked_age(const Person &p) {
+  if (p.age < 0) {
+    throw std::invalid_argument("negative age");
+  }
+  return p.age;
+}
+} // namespace
+
+using CheckedPersonMap = Attractadore::IndexedSlotMap<
+    Attractadore::DenseSlotMap<Person>, Attractadore::HashIndex<&Person::name>,
+    Attractadore::SortedIndex<&checked_age>>;
+
+TEST(TestIndexedSlotMap, InsertThrows) {
+  CheckedPersonMap s;
+  EXPECT_THROW(std::ignore = s.insert({"eve", -1}), std::invalid_argument);
+  EXPECT_TRUE(s.empty());
+  EXPECT_FALSE(s.index<0>().contains("eve"));
+}
+
+TEST(TestIndexedSlotMap, ModifyThrows) {
+  CheckedPersonMap s;
+  auto alice = s.insert({"alice", 30});
+  EXPECT_THROW(s.modify(alice,
+                        [](Person &p) {
+                          p.age = 40;
+                          throw std::runtime_error("modify failed");
+                        }),
+               std::runtime_error);
+  EXPECT_EQ(s.index<1>().find(40), alice);
+  EXPECT_EQ(s.index<0>().find("alice"), alice);
+
+  EXPECT_THROW(s.modify(alice, [](Person &p) { p.age = -1; }),
+               std::invalid_argument);
+  EXPECT_FALSE(s.contains(alice));
+  EXPECT_FALSE(s.index<0>().contains("alice"));
+  EXPECT_FALSE(s.index<1>().contains(40));
+
+  auto bob = s.insert({"bob", 25});
+  EXPECT_EQ(s.modify(bob, [](Person &p) { return ++p.age; }), 26);
+  EXPECT_EQ(s.index<1>().find(26), bob);
+}
@@ -0,0 +1,140 @@
+#include "Attractadore/KeyRegistry.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <string>
+
+using Attractadore::AttachedStore;
+using Attractadore::KeyRegistry;
+
+TEST(TestKeyRegistry, CreateDestroy) {
+  KeyRegistry<> r;
+  auto k = r.create();
+  EXPECT_TRUE(r.contains(k));
+  EXPECT_EQ(r.size(), 1);
+  r.destroy(k);
+  EXPECT_FALSE(r.contains(k));
+  EXPECT_TRUE(r.empty());
+  auto k2 = r.create();
+  EXPECT_NE(k, k2);
+  EXPECT_TRUE(r.contains(k2));
+  EXPECT_FALSE(r.try_destroy(k));
+  EXPECT_TRUE(r.try_destroy(k2));
+}
+
+TEST(TestAttachedStore, EmplaceFind) {
+  KeyRegistry<> r;
+  AttachedStore<int> ints(r);
+  AttachedStore<std::string> strings(r);
+  auto k1 = r.create();
+  auto k2 = r.create();
+  auto it = ints.emplace(k1, 1);
+  EXPECT_EQ(it->first, k1);
+  EXPECT_EQ(it->second, 1);
+  strings.emplace(k2, "two");
+  EXPECT_TRUE(ints.contains(k1));
+  EXPECT_FALSE(ints.contains(k2));
+  EXPECT_FALSE(strings.contains(k1));
+  EXPECT_EQ(strings[k2], "two");
+  EXPECT_EQ(ints.get(k2), nullptr);
+  EXPECT_EQ(ints.find(k2), ints.end());
+}
+
+TEST(TestAttachedStore, DestroyCascades) {
+  KeyRegistry<> r;
+  AttachedStore<int> ints(r);
+  AttachedStore<float> floats(r);
+  std::vector<decltype(r)::key_type> keys;
+  for (int i = 0; i < 8; i++) {
+    auto k = r.create();
+    keys.push_back(k);
+    ints.emplace(k, i);
+    if (i % 2 == 0) {
+      floats.emplace(k, i * 0.5f);
+    }
+  }
+  r.destroy(keys[0]);
+  r.destroy(keys[3]);
+  EXPECT_EQ(ints.size(), 6);
+  EXPECT_EQ(floats.size(), 3);
+  EXPECT_FALSE(ints.contains(keys[0]));
+  EXPECT_FALSE(floats.contains(keys[0]));
+  for (auto [k, v] : ints) {
+    EXPECT_EQ(v, std::ranges::find(keys, k) - keys.begin());
+  }
+
+  // A new key reusing a destroyed slot is not present in any store
+  auto k = r.create();
+  EXPECT_FALSE(ints.contains(k));
+  EXPECT_FALSE(ints.contains(keys[3]));
+}
+
+TEST(TestAttachedStore, Erase) {
+  KeyRegistry<> r;
+  AttachedStore<int> ints(r);
+  auto k1 = r.create();
+  auto k2 = r.create();
+  ints.emplace(k1, 1);
+  ints.emplace(k2, 2);
+  ints.erase(k1);
+  EXPECT_TRUE(r.contains(k1));
+  EXPECT_FALSE(ints.contains(k1));
+  EXPECT_EQ(ints[k2], 2);
+  EXPECT_FALSE(ints.try_erase(k1));
+  EXPECT_TRUE(ints.try_erase(k2));
+  EXPECT_TRUE(ints.empty());
+}
+
+TEST(TestAttachedStore, Clear) {
+  KeyRegistry<> r;
+  AttachedStore<int> ints(r);
+  auto k = r.create();
+  ints.emplace(k, 1);
+  r.clear();
+  EXPECT_TRUE(r.empty());
+  EXPECT_TRUE(ints.empty());
+  EXPECT_FALSE(r.contains(k));
+  auto k2 = r.create();
+  EXPECT_FALSE(ints.contains(k2));
+  ints.emplace(k2, 2);
+  EXPECT_EQ(ints[k2], 2);
+}
+
+TEST(TestAttachedStore, Detach) {
+  KeyRegistry<> r;
+  auto k = r.create();
+  {
+    AttachedStore<int> ints(r);
+    ints.emplace(k, 1);
+  }
+  r.destroy(k);
+  EXPECT_TRUE(r.empty());
+}
+
+TEST(TestAttachedStore, OutlivesRegistry) {
+  auto r = std::make_unique<KeyRegistry<>>();
+  AttachedStore<int> ints(*r);
+  auto k = r->create();
+  ints.emplace(k, 1);
+  r.reset();
+  EXPECT_TRUE(ints.empty());
+  EXPECT_FALSE(ints.contains(k));
+}
+
+TEST(TestAttachedStore, KeysFromRegistry) {
+  KeyRegistry<> r;
+  AttachedStore<int> ints(r);
+  auto k1 = r.create();
+  r.destroy(k1);
+  auto k2 = r.create();
+  auto k3 = r.create();
+  ints.emplace(k3, 3);
+  ints.emplace(k2, 2);
+  EXPECT_TRUE(std::ranges::equal(ints.keys(), std::array{k3, k2}));
+  for (auto [k, v] : ints) {
+    EXPECT_EQ(ints[k], v);
+  }
+}
@@ -0,0 +1,144 @@
+#include "Attractadore/PolySlotMap.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace {
+struct Shape {
+  int id = 0;
+};
+
+struct Circle : Shape {
+  float radius = 0.0f;
+};
+
+struct Rect : Shape {
+  float width = 0.0f;
+  float height = 0.0f;
+};
+
+struct Label : Shape {
+  std::string text;
+};
+} // namespace
+
+using ShapeMap = Attractadore::PolySlotMap<Shape, Circle, Rect, Label>;
+
+TEST(TestPolySlotMap, EmplaceFind) {
+  ShapeMap s;
+  auto c = s.emplace<Circle>(Circle{{1}, 2.0f});
+  auto r = s.insert(Rect{{2}, 3.0f, 4.0f});
+  auto l = s.emplace<Label>(Label{{3}, "three"});
+  EXPECT_EQ(s.size(), 3);
+
+  auto h = s.find(c);
+  ASSERT_TRUE(h);
+  EXPECT_TRUE(h.holds<Circle>());
+  EXPECT_FALSE(h.holds<Rect>());
+  EXPECT_EQ(h.get_if<Circle>()->radius, 2.0f);
+  EXPECT_EQ(h.get_if<Rect>(), nullptr);
+  EXPECT_EQ(h->id, 1);
+
+  EXPECT_EQ(s.get<Rect>(r)->width, 3.0f);
+  EXPECT_EQ(s.get<Circle>(r), nullptr);
+  EXPECT_EQ(s.get(l)->id, 3);
+  EXPECT_EQ(s.get<Label>(l)->text, "three");
+
+  auto area = s.find(r).visit([](auto &shape) -> float {
+    if constexpr (std::same_as<std::remove_cvref_t<decltype(shape)>, Rect>) {
+      return shape.width * shape.height;
+    } else {
+      return 0.0f;
+    }
+  });
+  EXPECT_EQ(area, 12.0f);
+}
+
+TEST(TestPolySlotMap, Erase) {
+  ShapeMap s;
+  std::vector<ShapeMap::key_type> keys;
+  for (int i = 0; i < 9; i++) {
+    switch (i % 3) {
+    case 0:
+      keys.push_back(s.insert(Circle{{i}}));
+      break;
+    case 1:
+      keys.push_back(s.insert(Rect{{i}}));
+      break;
+    default:
+      keys.push_back(s.insert(Label{{i}, "label"}));
+      break;
+    }
+  }
+  s.erase(keys[0]);
+  s.erase(keys[4]);
+  EXPECT_FALSE(s.contains(keys[0]));
+  EXPECT_FALSE(s.try_erase(keys[4]));
+  EXPECT_EQ(s.size(), 7);
+  EXPECT_EQ(s.values<Circle>().size(), 2);
+  EXPECT_EQ(s.values<Rect>().size(), 2);
+  for (int i = 0; i < 9; i++) {
+    if (i != 0 and i != 4) {
+      EXPECT_EQ(s.get(keys[i])->id, i);
+    }
+  }
+
+  // Freed slot is reused with a new version
+  auto k = s.insert(Rect{{100}});
+  EXPECT_FALSE(s.contains(keys[0]));
+  EXPECT_FALSE(s.contains(keys[4]));
+  EXPECT_EQ(s.get(k)->id, 100);
+}
+
+TEST(TestPolySlotMap, Visit) {
+  ShapeMap s;
+  for (int i = 0; i < 6; i++) {
+    std::ignore = s.insert(Circle{{i}});
+    std::ignore = s.insert(Rect{{i}});
+  }
+  int circles = 0;
+  int rects = 0;
+  s.visit([&]<typename D>(D &shape) {
+    if constexpr (std::same_as<D, Circle>) {
+      circles++;
+      shape.radius = 1.0f;
+    } else if constexpr (std::same_as<D, Rect>) {
+      rects++;
+    }
+  });
+  EXPECT_EQ(circles, 6);
+  EXPECT_EQ(rects, 6);
+  for (const auto &c : s.values<Circle>()) {
+    EXPECT_EQ(c.radius, 1.0f);
+  }
+}
+
+TEST(TestPolySlotMap, Clear) {
+  ShapeMap s;
+  auto k = s.insert(Circle{});
+  s.clear();
+  EXPECT_TRUE(s.empty());
+  EXPECT_FALSE(s.contains(k));
+  EXPECT_FALSE(s.find(k));
+  auto k2 = s.insert(Label{});
+  EXPECT_TRUE(s.contains(k2));
+}
+
+TEST(TestPolySlotMap, ForeignKey) {
+  ShapeMap s;
+  s.erase(s.insert(Circle{}));
+  ShapeMap other;
+  other.erase(other.insert(Circle{}));
+  // Matches the version that the free slot of s hands out next
+  auto k = other.insert(Rect{});
+  EXPECT_FALSE(s.contains(k));
+  EXPECT_FALSE(s.find(k));
+  EXPECT_EQ(s.get(k), nullptr);
+  // Out of range for s
+  auto k2 = other.insert(Label{});
+  EXPECT_FALSE(s.contains(k2));
+  EXPECT_FALSE(s.find(k2));
+  EXPECT_TRUE(other.contains(k));
+  EXPECT_TRUE(other.contains(k2));
+}
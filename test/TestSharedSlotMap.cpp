@@ -0,0 +1,178 @@
+#include "Attractadore/SharedSlotMap.hpp"
+
+#include <gtest/gtest.h>
+
+#if __has_include(<sys/mman.h>)
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+
+using Attractadore::SharedSlotMap;
+using Attractadore::SharedSlotMapReader;
+
+namespace {
+struct SharedMemory {
+  std::string name = "/attractadore-test-" + std::to_string(::getpid());
+
+  SharedMemory() { ::shm_unlink(name.c_str()); }
+  ~SharedMemory() { ::shm_unlink(name.c_str()); }
+};
+} // namespace
+
+TEST(TestSharedSlotMap, WriterReader) {
+  SharedMemory shm;
+  auto w = SharedSlotMap<int>::create(shm.name.c_str(), 16);
+  auto r = SharedSlotMapReader<int>::open(shm.name.c_str());
+  EXPECT_EQ(r.capacity(), 16);
+  auto k1 = w.insert(1);
+  auto k2 = w.insert(2);
+  EXPECT_EQ(r.size(), 2);
+  EXPECT_EQ(r.get(k1), 1);
+  EXPECT_EQ(r.get(k2), 2);
+  w.assign(k1, 10);
+  EXPECT_EQ(r.get(k1), 10);
+  w.erase(k1);
+  EXPECT_FALSE(r.contains(k1));
+  EXPECT_EQ(r.get(k2), 2);
+  auto k3 = w.insert(3);
+  EXPECT_NE(k3, k1);
+  EXPECT_EQ(r.get(k3), 3);
+  int sum = 0;
+  r.for_each([&](auto, int v) { sum += v; });
+  EXPECT_EQ(sum, 5);
+  w.clear();
+  EXPECT_TRUE(r.empty());
+  EXPECT_FALSE(r.contains(k2));
+}
+
+TEST(TestSharedSlotMap, Full) {
+  SharedMemory shm;
+  auto w = SharedSlotMap<int>::create(shm.name.c_str(), 4);
+  for (int i = 0; i < 4; i++) {
+    auto k = w.insert(i);
+    EXPECT_EQ(w[k], i);
+  }
+  EXPECT_TRUE(w.full());
+}
+
+TEST(TestSharedSlotMap, Batch) {
+  SharedMemory shm;
+  auto w = SharedSlotMap<int>::create(shm.name.c_str(), 16);
+  auto r = SharedSlotMapReader<int>::open(shm.name.c_str());
+  w.batch([](auto &w) {
+    for (int i = 0; i < 8; i++) {
+      auto k = w.insert(i);
+      EXPECT_TRUE(w.contains(k));
+    }
+  });
+  EXPECT_EQ(r.size(), 8);
+}
+
+TEST(TestSharedSlotMap, ConcurrentReads) {
+  struct Pair {
+    uint64_t a, b;
+  };
+  SharedMemory shm;
+  auto w = SharedSlotMap<Pair>::create(shm.name.c_str(), 64);
+  auto r = SharedSlotMapReader<Pair>::open(shm.name.c_str());
+  auto k = w.insert(Pair{0, 0});
+  std::atomic<bool> done = false;
+  std::thread reader([&] {
+    while (not done) {
+      auto p = r.get(k);
+      ASSERT_TRUE(p);
+      EXPECT_EQ(p->a, p->b);
+    }
+  });
+  for (uint64_t i = 1; i < 100000; i++) {
+    w.assign(k, {i, i});
+    auto tmp = w.insert(Pair{i, i});
+    w.erase(tmp);
+  }
+  done = true;
+  reader.join();
+}
+
+TEST(TestSharedSlotMap, ForkedReader) {
+  struct Pair {
+    uint64_t a, b;
+  };
+  SharedMemory shm;
+  auto w = SharedSlotMap<Pair>::create(shm.name.c_str(), 64);
+  auto k = w.insert(Pair{0, 0});
+  auto pid = ::fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    auto r = SharedSlotMapReader<Pair>::open(shm.name.c_str());
+    for (int i = 0; i < 100000; i++) {
+      auto p = r.get(k);
+      if (not p or p->a != p->b) {
+        ::_exit(1);
+      }
+    }
+    ::_exit(0);
+  }
+  int status = 0;
+  for (uint64_t i = 1; ::waitpid(pid, &status, WNOHANG) == 0; i++) {
+    w.assign(k, {i, i});
+    auto tmp = w.insert(Pair{i, i});
+    w.erase(tmp);
+  }
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+TEST(TestSharedSlotMap, WriterDiesMidWrite) {
+  SharedMemory shm;
+  auto w = SharedSlotMap<int>::create(shm.name.c_str(), 16);
+  auto k = w.insert(1);
+  auto pid = ::fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    w.batch([](auto &w) {
+      std::ignore = w.insert(2);
+      ::_exit(0);
+    });
+  }
+  int status = 0;
+  ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+  auto r = SharedSlotMapReader<int>::open(shm.name.c_str());
+  r.set_timeout(std::chrono::milliseconds(10));
+  try {
+    std::ignore = r.get(k);
+    FAIL() << "Read did not time out";
+  } catch (const std::system_error &e) {
+    EXPECT_EQ(e.code(), std::errc::timed_out);
+  }
+}
+
+TEST(TestSharedSlotMap, FreeSlotVersion) {
+  SharedMemory shm;
+  auto w = SharedSlotMap<int>::create(shm.name.c_str(), 16);
+  auto r = SharedSlotMapReader<int>::open(shm.name.c_str());
+  SharedMemory other_shm;
+  other_shm.name += "-other";
+  auto other = SharedSlotMap<int>::create(other_shm.name.c_str(), 16);
+  std::vector<SharedSlotMap<int>::key_type> keys;
+  for (int i = 0; i < 4; i++) {
+    keys.push_back(w.insert(i));
+  }
+  // Slot 0 is free in w with the version of k and links to slot 1, which is
+  // a valid dense index
+  w.erase(keys[1]);
+  w.erase(keys[0]);
+  other.erase(other.insert(0));
+  auto k = other.insert(1);
+  EXPECT_FALSE(w.contains(k));
+  EXPECT_FALSE(r.contains(k));
+}
+
+TEST(TestSharedSlotMap, RejectsMismatchedValueType) {
+  SharedMemory shm;
+  auto w = SharedSlotMap<int>::create(shm.name.c_str(), 4);
+  EXPECT_THROW(SharedSlotMapReader<double>::open(shm.name.c_str()),
+               std::system_error);
+}
+#endif
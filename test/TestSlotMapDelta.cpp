@@ -0,0 +1,177 @@
+#include "Attractadore/SlotMapDelta.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+
+using Attractadore::DenseSlotMap;
+using Attractadore::SlotMapDelta;
+
+TEST(TestSlotMapDelta, Empty) {
+  DenseSlotMap<int> s;
+  auto k = s.insert(1);
+  auto delta = diff(s, s);
+  EXPECT_TRUE(delta.empty());
+  auto replica = s;
+  EXPECT_TRUE(delta.apply(replica));
+  EXPECT_EQ(replica[k], 1);
+}
+
+TEST(TestSlotMapDelta, InsertedErasedChanged) {
+  DenseSlotMap<int> s;
+  auto k1 = s.insert(1);
+  auto k2 = s.insert(2);
+  auto k3 = s.insert(3);
+  auto replica = s;
+  auto old = s;
+  s.erase(k1);
+  s[k2] = 20;
+  auto k4 = s.insert(4);
+  auto delta = diff(old, s);
+  EXPECT_EQ(delta.erased().size(), 1);
+  EXPECT_EQ(delta.changed().size(), 1);
+  EXPECT_EQ(delta.inserted().size(), 1);
+  ASSERT_TRUE(delta.apply(replica));
+  EXPECT_FALSE(replica.contains(k1));
+  EXPECT_EQ(replica[k2], 20);
+  EXPECT_EQ(replica[k3], 3);
+  EXPECT_EQ(replica[k4], 4);
+  EXPECT_EQ(replica.size(), s.size());
+}
+
+TEST(TestSlotMapDelta, Mismatch) {
+  DenseSlotMap<int> s;
+  auto k = s.insert(1);
+  auto old = s;
+  s.erase(k);
+  DenseSlotMap<int> replica;
+  EXPECT_FALSE(diff(old, s).apply(replica));
+}
+
+TEST(TestSlotMapDelta, MismatchKeepsFreeList) {
+  DenseSlotMap<int> s;
+  DenseSlotMap<int> replica;
+  using Key = decltype(s)::key_type;
+  std::vector<Key> keys;
+  for (int i = 0; i < 4; i++) {
+    keys.push_back(s.insert(i));
+    std::ignore = replica.insert(i);
+  }
+  for (int i = 0; i < 4; i++) {
+    s.erase(keys[i]);
+    replica.erase(keys[3 - i]);
+  }
+  auto old = s;
+  for (int i = 0; i < 4; i++) {
+    std::ignore = s.insert(i);
+  }
+  // Only the last inserted slot is taken in replica
+  auto taken = replica.insert(-1);
+  EXPECT_FALSE(diff(old, s).apply(replica));
+  EXPECT_EQ(replica[taken], -1);
+  std::vector<Key> inserted;
+  for (int i = 0; i < 8; i++) {
+    inserted.push_back(replica.insert(i));
+  }
+  EXPECT_EQ(replica[taken], -1);
+  for (int i = 0; i < 8; i++) {
+    EXPECT_EQ(replica[inserted[i]], i);
+  }
+}
+
+TEST(TestSlotMapDelta, ActiveState) {
+  DenseSlotMap<int> s;
+  auto k1 = s.insert(1);
+  auto k2 = s.insert(2);
+  auto k3 = s.insert(3);
+  s.set_active(k2, false);
+  auto replica = s;
+  auto old = s;
+  s.set_active(k1, false);
+  s.set_active(k2, true);
+  auto k4 = s.insert(4);
+  auto k5 = s.insert(5);
+  s.set_active(k4, false);
+  auto delta = diff(old, s);
+  EXPECT_EQ(delta.changed().size(), 2);
+  EXPECT_EQ(delta.inserted().size(), 2);
+  ASSERT_TRUE(delta.apply(replica));
+  EXPECT_EQ(replica.active_size(), s.active_size());
+  for (auto k : {k1, k2, k3, k4, k5}) {
+    EXPECT_EQ(replica.is_active(k), s.is_active(k));
+    EXPECT_EQ(replica[k], s[k]);
+  }
+}
+
+TEST(TestSlotMapDelta, NonTrivialValues) {
+  DenseSlotMap<std::string> s;
+  auto k = s.insert("a");
+  auto replica = s;
+  auto old = s;
+  s[k] = "b";
+  auto delta = diff(old, s);
+  EXPECT_EQ(delta.changed().size(), 1);
+  ASSERT_TRUE(delta.apply(replica));
+  EXPECT_EQ(replica[k], "b");
+}
+
+TEST(TestSlotMapDelta, Random) {
+  DenseSlotMap<int> primary;
+  DenseSlotMap<int> replica;
+  std::mt19937 rng(0);
+  std::vector<DenseSlotMap<int>::key_type> keys;
+  for (int round = 0; round < 20; round++) {
+    auto old = primary;
+    for (int i = 0; i < 50; i++) {
+      auto op = rng() % 3;
+      if (op == 0 or keys.empty()) {
+        keys.push_back(primary.insert(int(rng())));
+      } else {
+        auto j = rng() % keys.size();
+        if (op == 1) {
+          std::ignore = primary.try_erase(keys[j]);
+          keys.erase(keys.begin() + j);
+        } else {
+          primary[keys[j]] = int(rng());
+        }
+      }
+    }
+    if (round % 7 == 6) {
+      primary.clear();
+      keys.clear();
+      keys.push_back(primary.insert(0));
+    }
+    ASSERT_TRUE(diff(old, primary).apply(replica));
+    ASSERT_EQ(replica.size(), primary.size());
+    for (auto [k, v] : primary) {
+      ASSERT_TRUE(replica.contains(k));
+      EXPECT_EQ(replica[k], v);
+    }
+    // The free lists match, so both hand out the same keys next
+    auto next_primary = primary;
+    auto next_replica = replica;
+    for (int i = 0; i < 40; i++) {
+      ASSERT_EQ(next_primary.insert(i), next_replica.insert(i));
+    }
+  }
+}
+
+TEST(TestSlotMapDelta, SlotRecords) {
+  DenseSlotMap<int> s;
+  std::vector<DenseSlotMap<int>::key_type> keys;
+  for (int i = 0; i < 64; i++) {
+    keys.push_back(s.insert(i));
+  }
+  auto replica = s;
+  auto old = s;
+  s.erase(keys[10]);
+  s[keys[20]] = -1;
+  auto delta = diff(old, s);
+  // Only the erased slot is recorded, not every free slot
+  EXPECT_EQ(delta.slots().size(), 1);
+  EXPECT_FALSE(delta.empty());
+  ASSERT_TRUE(delta.apply(replica));
+  EXPECT_EQ(replica.insert(0), s.insert(0));
+  EXPECT_TRUE(diff(s, s).empty());
+}
@@ -0,0 +1,139 @@
+#include "Attractadore/SlotMapJournal.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <stdexcept>
+
+using Attractadore::DenseSlotMap;
+using Attractadore::JournaledSlotMap;
+using Attractadore::MemoryJournalSink;
+
+using Journaled = JournaledSlotMap<DenseSlotMap<int>, MemoryJournalSink>;
+
+TEST(TestJournal, Replay) {
+  Journaled s(MemoryJournalSink{}, 0);
+  std::vector<Journaled::key_type> keys;
+  for (int i = 0; i < 16; i++) {
+    keys.push_back(s.insert(i));
+  }
+  s.erase(keys[3]);
+  EXPECT_EQ(s.pop(keys[7]), 7);
+  s.assign(keys[5], 50);
+  keys.push_back(s.insert(100));
+
+  auto replayed = Journaled::replay(s.sink().bytes);
+  ASSERT_TRUE(replayed);
+  EXPECT_EQ(*replayed, s.map());
+  EXPECT_EQ((*replayed)[keys[5]], 50);
+  EXPECT_EQ((*replayed)[keys.back()], 100);
+  EXPECT_FALSE(replayed->contains(keys[3]));
+}
+
+TEST(TestJournal, GroupCommit) {
+  Journaled s(MemoryJournalSink{}, 1024);
+  auto k = s.insert(1);
+  EXPECT_TRUE(s.sink().bytes.empty());
+  s.commit();
+  EXPECT_FALSE(s.sink().bytes.empty());
+  auto replayed = Journaled::replay(s.sink().bytes);
+  ASSERT_TRUE(replayed);
+  EXPECT_EQ((*replayed)[k], 1);
+}
+
+TEST(TestJournal, Checkpoint) {
+  Journaled s(MemoryJournalSink{}, 0);
+  std::vector<Journaled::key_type> keys;
+  for (int i = 0; i < 16; i++) {
+    keys.push_back(s.insert(i));
+  }
+  s.erase(keys[0]);
+  s.clear();
+  for (int i = 0; i < 4; i++) {
+    keys.push_back(s.insert(i));
+  }
+  s.erase(keys[17]);
+  auto size = s.sink().bytes.size();
+  s.checkpoint();
+  EXPECT_LT(s.sink().bytes.size(), size);
+
+  // Allocation after replaying a checkpoint matches the original
+  auto k = s.insert(42);
+  auto replayed = Journaled::replay(s.sink().bytes);
+  ASSERT_TRUE(replayed);
+  EXPECT_EQ(*replayed, s.map());
+  EXPECT_EQ((*replayed)[k], 42);
+  EXPECT_FALSE(replayed->contains(keys[0]));
+  EXPECT_FALSE(replayed->contains(keys[17]));
+  auto k2 = replayed->insert(0);
+  EXPECT_EQ(k2, s.insert(0));
+}
+
+// Sink that fails to discard the old log
+struct KeepingJournalSink : MemoryJournalSink {
+  void discard_before(size_t) { throw std::runtime_error("discard failed"); }
+};
+
+TEST(TestJournal, CheckpointBeforeDiscard) {
+  JournaledSlotMap<DenseSlotMap<int>, KeepingJournalSink> s(
+      KeepingJournalSink{}, 0);
+  std::vector<Journaled::key_type> keys;
+  for (int i = 0; i < 8; i++) {
+    keys.push_back(s.insert(i));
+  }
+  s.erase(keys[2]);
+  EXPECT_THROW(s.checkpoint(), std::runtime_error);
+  auto replayed = Journaled::replay(s.sink().bytes);
+  ASSERT_TRUE(replayed);
+  EXPECT_EQ(*replayed, s.map());
+}
+
+// Sink that fails to append
+struct FailingJournalSink : MemoryJournalSink {
+  void append(std::span<const std::byte>) {
+    throw std::runtime_error("append failed");
+  }
+};
+
+TEST(TestJournal, DestroyWithFailingSink) {
+  JournaledSlotMap<DenseSlotMap<int>, FailingJournalSink> s(
+      FailingJournalSink{}, 1024);
+  std::ignore = s.insert(1);
+  EXPECT_THROW(s.commit(), std::runtime_error);
+}
+
+TEST(TestJournal, CorruptCheckpoint) {
+  Journaled s(MemoryJournalSink{}, 0);
+  std::vector<Journaled::key_type> keys;
+  for (int i = 0; i < 8; i++) {
+    keys.push_back(s.insert(i));
+  }
+  s.erase(keys[2]);
+  s.erase(keys[5]);
+  s.checkpoint();
+  ASSERT_TRUE(Journaled::replay(s.sink().bytes));
+  // Op, then key count, slot count, free head, lazy free and active end,
+  // the version floor and maximum, and the keys
+  constexpr size_t free_head = 1 + 2 * sizeof(uint32_t);
+  constexpr size_t first_key = 1 + 7 * sizeof(uint32_t);
+  auto corrupt = [&](size_t offset, uint32_t value) {
+    auto log = s.sink().bytes;
+    std::memcpy(log.data() + offset, &value, sizeof(value));
+    return Journaled::replay(log);
+  };
+  uint32_t second_slot;
+  std::memcpy(&second_slot, s.sink().bytes.data() + first_key + 8,
+              sizeof(second_slot));
+  EXPECT_FALSE(corrupt(free_head, 100));
+  EXPECT_FALSE(corrupt(free_head, second_slot));
+  EXPECT_FALSE(corrupt(first_key, 100));
+  EXPECT_FALSE(corrupt(first_key, second_slot));
+}
+
+TEST(TestJournal, Corrupt) {
+  Journaled s(MemoryJournalSink{}, 0);
+  std::ignore = s.insert(1);
+  auto log = s.sink().bytes;
+  log.pop_back();
+  EXPECT_FALSE(Journaled::replay(log));
+}
@@ -0,0 +1,107 @@
+#include "Attractadore/TtlSlotMap.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+using Attractadore::TtlSlotMap;
+
+TEST(TestTtlSlotMap, Expire) {
+  TtlSlotMap<int> s;
+  auto k1 = s.emplace_with_ttl(10, 1);
+  auto k2 = s.emplace_with_ttl(20, 2);
+  auto k3 = s.emplace(3);
+  EXPECT_EQ(s.expire(9), 0);
+  EXPECT_EQ(s.size(), 3);
+  EXPECT_EQ(s.expire(10), 1);
+  EXPECT_FALSE(s.contains(k1));
+  EXPECT_TRUE(s.contains(k2));
+  EXPECT_EQ(s.expire(1000), 1);
+  EXPECT_FALSE(s.contains(k2));
+  EXPECT_TRUE(s.contains(k3));
+}
+
+TEST(TestTtlSlotMap, Refresh) {
+  TtlSlotMap<int> s;
+  auto k = s.emplace_with_ttl(10, 1);
+  s.refresh(k, 100);
+  EXPECT_EQ(s.deadline(k), 100);
+  EXPECT_EQ(s.expire(50), 0);
+  EXPECT_TRUE(s.contains(k));
+  s.refresh(k, TtlSlotMap<int>::NEVER);
+  EXPECT_EQ(s.expire(200), 0);
+  EXPECT_TRUE(s.contains(k));
+}
+
+TEST(TestTtlSlotMap, EraseBeforeExpiry) {
+  TtlSlotMap<int> s;
+  auto k = s.emplace_with_ttl(10, 1);
+  s.erase(k);
+  // Slot is reused by an element with a later deadline
+  auto k2 = s.emplace_with_ttl(20, 2);
+  EXPECT_EQ(s.expire(10), 0);
+  EXPECT_TRUE(s.contains(k2));
+  EXPECT_EQ(s.expire(20), 1);
+}
+
+TEST(TestTtlSlotMap, Callback) {
+  TtlSlotMap<int> s;
+  auto k = s.emplace_with_ttl(5, 42);
+  int expired = 0;
+  s.expire(5, [&](auto key, int &v) {
+    EXPECT_EQ(key, k);
+    expired = v;
+  });
+  EXPECT_EQ(expired, 42);
+}
+
+TEST(TestTtlSlotMap, FarDeadlines) {
+  TtlSlotMap<uint64_t> s;
+  std::mt19937_64 rng(0);
+  std::vector<uint64_t> deadlines;
+  for (int i = 0; i < 1000; i++) {
+    auto d = rng() % (uint64_t(1) << 20);
+    deadlines.push_back(d);
+    auto k = s.emplace_with_ttl(d, d);
+    EXPECT_EQ(s.deadline(k), d);
+  }
+  std::ranges::sort(deadlines);
+  uint64_t now = 0;
+  size_t expired = 0;
+  for (size_t i = 0; i < deadlines.size(); i += 100) {
+    now = deadlines[i];
+    expired += s.expire(now, [&](auto, uint64_t d) { EXPECT_LE(d, now); });
+    for (auto d : s.values()) {
+      EXPECT_GT(d, now);
+    }
+  }
+  EXPECT_EQ(expired + s.size(), deadlines.size());
+}
+
+TEST(TestTtlSlotMap, DeadlineNotAfterNow) {
+  TtlSlotMap<int> s;
+  EXPECT_EQ(s.expire(100), 0);
+  auto past = s.emplace_with_ttl(50, 1);
+  auto now = s.emplace_with_ttl(100, 2);
+  EXPECT_EQ(s.deadline(past), 101);
+  EXPECT_EQ(s.expire(100), 0);
+  EXPECT_EQ(s.expire(101), 2);
+  EXPECT_FALSE(s.contains(past));
+  EXPECT_FALSE(s.contains(now));
+  auto k = s.emplace_with_ttl(200, 3);
+  s.refresh(k, 0);
+  EXPECT_EQ(s.expire(102), 1);
+}
+
+TEST(TestTtlSlotMap, LongIdle) {
+  TtlSlotMap<int> s;
+  for (int i = 0; i < 100; i++) {
+    auto k = s.emplace_with_ttl(10, i);
+    s.erase(k);
+  }
+  auto k = s.emplace_with_ttl(uint64_t(1) << 40, 0);
+  EXPECT_EQ(s.expire(uint64_t(1) << 39), 0);
+  EXPECT_TRUE(s.contains(k));
+  EXPECT_EQ(s.expire(uint64_t(1) << 40), 1);
+  EXPECT_EQ(s.expire(uint64_t(1) << 62), 0);
+}